@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+// heap array of trivially copyable T aligned to ALIGNMENT bytes (cache line by default)
+template<typename T, size_t ALIGNMENT = 64>
+class AlignedBuffer
+{
+public:
+	AlignedBuffer() = default;
+	explicit AlignedBuffer(size_t count) { resize(count); }
+	~AlignedBuffer() { release(); }
+
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	AlignedBuffer(AlignedBuffer&& other) noexcept
+		: m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+	AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+		}
+		return *this;
+	}
+
+	// contents are not preserved
+	void resize(size_t count)
+	{
+		if (count == m_size)
+		{
+			return;
+		}
+		release();
+		if (count > 0)
+		{
+			size_t bytes = (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+#ifdef _MSC_VER
+			m_data = static_cast<T*>(_aligned_malloc(bytes, ALIGNMENT));
+#else
+			m_data = static_cast<T*>(std::aligned_alloc(ALIGNMENT, bytes));
+#endif
+			if (m_data == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+			m_size = count;
+		}
+	}
+
+	T* data() { return m_data; }
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+	T& operator[](size_t i) { return m_data[i]; }
+	const T& operator[](size_t i) const { return m_data[i]; }
+
+private:
+	void release()
+	{
+#ifdef _MSC_VER
+		_aligned_free(m_data);
+#else
+		std::free(m_data);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	T* m_data = nullptr;
+	size_t m_size = 0;
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// heap allocations through operator new since the start of the program. the counting operator new / delete live in
+// allocationcounter.cpp, linked into the bench only, in a translation unit of their own so no call site inlines them
+uint64_t getAllocationCount();
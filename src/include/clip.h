@@ -1,9 +1,28 @@
 #pragma once
 #include <iostream>
 #include <array>
+#include <vector>
+#include <utility>
+#include <cstdint>
 
 #include "vertex.h"
 
+// outcode bits: the vertex is outside the plane x <= w, x >= -w, ... plain uint32_t constants rather than an enum,
+// outcodes are built and masked as integers
+static constexpr uint32_t CLIP_X_POSITIVE = 1u << 0;
+static constexpr uint32_t CLIP_X_NEGATIVE = 1u << 1;
+static constexpr uint32_t CLIP_Y_POSITIVE = 1u << 2;
+static constexpr uint32_t CLIP_Y_NEGATIVE = 1u << 3;
+static constexpr uint32_t CLIP_Z_POSITIVE = 1u << 4;
+static constexpr uint32_t CLIP_Z_NEGATIVE = 1u << 5;
+// outside the guard band: |x| > guardBand.x * w, |y| > guardBand.y * w
+static constexpr uint32_t CLIP_GUARD_X = 1u << 6;
+static constexpr uint32_t CLIP_GUARD_Y = 1u << 7;
+
+static constexpr uint32_t CLIP_FRUSTUM = 0x3f;
+// classifyTriangles: the three vertices are outside the same frustum plane
+static constexpr uint32_t CLIP_REJECT = 1u << 31;
+
 template<typename Vertex>
 class Clipper
 {
@@ -56,7 +75,7 @@ public:
 			if (isAIn ^ isBIn)
 			{
 				float t = computeParamT<AXIS, W_SIGN>(A, B);
-				outVertices[outCount++] = interpolate<Vertex>(A, B, t);
+				outVertices[outCount++] = interpolate(A, B, t);
 			}
 			A = B;
 			isAIn = isBIn;
@@ -64,39 +83,140 @@ public:
 		return outCount;
 	}
 
-	bool isInner(const Vertex& A)
+	template<int AXIS, bool W_SIGN>
+	static constexpr uint32_t planeBit()
 	{
-		return abs(A.position.x) <= abs(A.position.w) &&
-			   abs(A.position.y) <= abs(A.position.w) &&
-			   isInBoundary<AXIS_FLAG::Z, W_SIGN_FLAG::POSITIVE>(A) &&
-			   isInBoundary<AXIS_FLAG::Z, W_SIGN_FLAG::NEGATIVE>(A);
+		return 1u << (2 * AXIS + (W_SIGN ? 0 : 1));
 	}
 
-	size_t clipTriangle(const Vertex* triangleVertices, Vertex* outputVertices, size_t verticesCount = 3)
+	// bit planeBit<AXIS, W_SIGN>() set for every plane the vertex is outside of, and the guard band bits
+	static uint32_t computeOutcode(const Vertex& vertex, const glm::vec2& guardBand = glm::vec2(1.0f))
 	{
-		if (TRIANGLE_VERTICES_COUNT != verticesCount)
+		const glm::vec4& p = vertex.position;
+		const float guardX = p.w * guardBand.x, guardY = p.w * guardBand.y;
+		return (p.w < p.x ? CLIP_X_POSITIVE : 0u) | (p.x < -p.w ? CLIP_X_NEGATIVE : 0u) |
+			   (p.w < p.y ? CLIP_Y_POSITIVE : 0u) | (p.y < -p.w ? CLIP_Y_NEGATIVE : 0u) |
+			   (p.w < p.z ? CLIP_Z_POSITIVE : 0u) | (p.z < -p.w ? CLIP_Z_NEGATIVE : 0u) |
+			   (guardX < p.x || p.x < -guardX ? CLIP_GUARD_X : 0u) | (guardY < p.y || p.y < -guardY ? CLIP_GUARD_Y : 0u);
+	}
+
+	// clips against the plane when one of the vertices is outside it, the result goes to the other buffer
+	template<int AXIS, bool W_SIGN>
+	void clipIfCrossed(uint32_t crossed, Vertex*& inVertices, Vertex*& outVertices, size_t& count)
+	{
+		if ((crossed & planeBit<AXIS, W_SIGN>()) != 0 && count != 0)
 		{
-			std::cout << "error triangle vertices count is not 3" << std::endl;
+			count = clipPolygonWithPlane<AXIS, W_SIGN>(inVertices, count, outVertices);
+			std::swap(inVertices, outVertices);
+		}
+	}
+
+	// planes clipTriangle clips the triangle against, 0 when it is drawn as it is. guardBand: x and y are only
+	// clipped when a vertex is outside the guard band, the rasterizer scissors the rest
+	static uint32_t clipPlanes(const uint32_t* outcodes, bool guardBand)
+	{
+		const uint32_t crossed = outcodes[0] | outcodes[1] | outcodes[2];
+		if (!guardBand)
+		{
+			return crossed & CLIP_FRUSTUM;
+		}
+		return (crossed & (CLIP_Z_POSITIVE | CLIP_Z_NEGATIVE)) |
+			   ((crossed & CLIP_GUARD_X) != 0 ? crossed & (CLIP_X_POSITIVE | CLIP_X_NEGATIVE) : 0) |
+			   ((crossed & CLIP_GUARD_Y) != 0 ? crossed & (CLIP_Y_POSITIVE | CLIP_Y_NEGATIVE) : 0);
+	}
+
+	// all three vertices outside the same plane
+	static bool isOutside(const uint32_t* outcodes)
+	{
+		return (outcodes[0] & outcodes[1] & outcodes[2] & CLIP_FRUSTUM) != 0;
+	}
+
+	// outcodes: computeOutcode of the three vertices, usually computed along with the vertex transform
+	size_t clipTriangle(const Vertex* triangleVertices, const uint32_t* outcodes, Vertex* outputVertices, bool guardBand = false)
+	{
+		if (isOutside(outcodes))
+		{
+			return 0;
 		}
-		
-		if (isInner(triangleVertices[0]) && isInner(triangleVertices[1]) && isInner(triangleVertices[2]))
+		// inside, or only crossing planes the rasterizer takes care of
+		const uint32_t crossed = clipPlanes(outcodes, guardBand);
+		if (crossed == 0)
 		{
 			assignData<Vertex>(outputVertices, &triangleVertices[0], 3);
-			return  3;
+			return 3;
 		}
-		std::array<Vertex, MAX_OUTPUT_CLIPPED_POINT> inVertices = {}, outVertices = {};
-		assignData<Vertex>(&inVertices[0], &triangleVertices[0], 3);
 
+		// only the planes an edge actually crosses, a polygon inside a plane stays inside it after clipping
+		std::array<Vertex, MAX_OUTPUT_CLIPPED_POINT> buffer0, buffer1;
+		assignData<Vertex>(&buffer0[0], &triangleVertices[0], 3);
+		Vertex* inVertices = &buffer0[0];
+		Vertex* outVertices = &buffer1[0];
 		size_t outCount = 3;
-		outCount = clipPolygonWithPlane<AXIS_FLAG::X, W_SIGN_FLAG::POSITIVE>(&inVertices[0],  outCount, &outVertices[0]);
-		outCount = clipPolygonWithPlane<AXIS_FLAG::X, W_SIGN_FLAG::NEGATIVE>(&outVertices[0], outCount, &inVertices[0]);
-		outCount = clipPolygonWithPlane<AXIS_FLAG::Y, W_SIGN_FLAG::POSITIVE>(&inVertices[0],  outCount, &outVertices[0]);
-		outCount = clipPolygonWithPlane<AXIS_FLAG::Y, W_SIGN_FLAG::NEGATIVE>(&outVertices[0], outCount, &inVertices[0]);
-		outCount = clipPolygonWithPlane<AXIS_FLAG::Z, W_SIGN_FLAG::POSITIVE>(&inVertices[0],  outCount, &outVertices[0]);
-		outCount = clipPolygonWithPlane<AXIS_FLAG::Z, W_SIGN_FLAG::NEGATIVE>(&outVertices[0], outCount, &inVertices[0]);
+		clipIfCrossed<AXIS_FLAG::X, W_SIGN_FLAG::POSITIVE>(crossed, inVertices, outVertices, outCount);
+		clipIfCrossed<AXIS_FLAG::X, W_SIGN_FLAG::NEGATIVE>(crossed, inVertices, outVertices, outCount);
+		clipIfCrossed<AXIS_FLAG::Y, W_SIGN_FLAG::POSITIVE>(crossed, inVertices, outVertices, outCount);
+		clipIfCrossed<AXIS_FLAG::Y, W_SIGN_FLAG::NEGATIVE>(crossed, inVertices, outVertices, outCount);
+		clipIfCrossed<AXIS_FLAG::Z, W_SIGN_FLAG::POSITIVE>(crossed, inVertices, outVertices, outCount);
+		clipIfCrossed<AXIS_FLAG::Z, W_SIGN_FLAG::NEGATIVE>(crossed, inVertices, outVertices, outCount);
 
-		assignData<Vertex>(outputVertices, &inVertices[0], outCount);
+		assignData<Vertex>(outputVertices, inVertices, outCount);
 
 		return outCount;
 	}
-};
\ No newline at end of file
+
+	size_t clipTriangle(const Vertex* triangleVertices, Vertex* outputVertices, size_t verticesCount = 3)
+	{
+		if (TRIANGLE_VERTICES_COUNT != verticesCount)
+		{
+			std::cout << "error triangle vertices count is not 3" << std::endl;
+		}
+		const uint32_t outcodes[3] = { computeOutcode(triangleVertices[0]), computeOutcode(triangleVertices[1]), computeOutcode(triangleVertices[2]) };
+		return clipTriangle(triangleVertices, outcodes, outputVertices);
+	}
+};
+
+// ======== BatchClipper ========
+
+// planes[i]: Clipper::clipPlanes of triangle i from the outcodes of its three vertices, or CLIP_REJECT when
+// Clipper::isOutside. 0 for a triangle drawn as it is
+void classifyTriangles(const uint32_t* outcodes0, const uint32_t* outcodes1, const uint32_t* outcodes2, size_t count,
+					   bool guardBand, uint32_t* planes);
+
+// clips triangles simd::WIDTH at a time, each lane a polygon in structure of arrays form. a plane pass is only run
+// for the groups with a lane crossing the plane, the other lanes are carried over. classifyTriangles sorts the
+// triangles of a batch first, so only the ones actually needing it are queued for clipping, and the queued triangles
+// crossing only near / far are grouped apart from the rest: their groups skip the four x / y passes.
+// defined in clip_impl.h, clip.cpp instantiates the layouts of the built-in shaders
+template<typename VertexT>
+class BatchClipper
+{
+public:
+	// position x, y, z, w and the varyings of a vertex
+	static constexpr int CHANNELS = 4 + VertexT::Layout::COUNT;
+	static constexpr int MAX_OUTPUT_CLIPPED_POINT = Clipper<VertexT>::MAX_OUTPUT_CLIPPED_POINT;
+
+	BatchClipper();
+	BatchClipper(BatchClipper&& other) noexcept;
+	BatchClipper& operator=(BatchClipper&& other) noexcept;
+	~BatchClipper();
+
+	void clear();
+	// queues triangle for clipping against planes, the polygons are numbered in queue order
+	void add(const TriangleT<VertexT>& triangle, uint32_t planes);
+	// guardBand: the guard band of the planes (see computeOutcode), vec2(1) clips x / y against the frustum.
+	// the x / y planes are only clipped when a vertex left by the near / far passes is outside the guard band
+	void clip(const glm::vec2& guardBand = glm::vec2(1.0f));
+	size_t getPolygonCount() const { return polygonSlots.size(); }
+	// vertices of a clipped polygon, at most MAX_OUTPUT_CLIPPED_POINT
+	size_t getPolygon(size_t polygon, VertexT* vertices) const;
+
+private:
+	struct Group;
+
+	std::vector<Group> groups;
+	size_t groupCount = 0;
+	// group being filled of the near / far only triangles and of the others
+	size_t openGroups[2] = {};
+	// group * simd::WIDTH + lane of every queued polygon
+	std::vector<uint32_t> polygonSlots;
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "clip.h"
+#include "simd.h"
+
+// the BatchClipper templates. clip.cpp instantiates them for the layouts of the built-in shaders, a translation unit
+// with a layout of its own includes this header (render_impl.h does)
+
+// simd::WIDTH polygons, vertices[buffer][vertex][channel][lane]. the plane passes ping-pong between the two buffers
+template<typename VertexT>
+struct BatchClipper<VertexT>::Group
+{
+	float vertices[2][MAX_OUTPUT_CLIPPED_POINT][CHANNELS][simd::WIDTH];
+	uint32_t counts[simd::WIDTH];
+	uint32_t planes[simd::WIDTH];
+	int current;
+	// lanes in use
+	int lanes;
+};
+
+// channel of w, x / y / z are the channels 0 - 2
+static constexpr int CHANNEL_W = 3;
+
+// most vertices of a clipped polygon, the same for every layout
+static constexpr int MAX_POINTS = Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT;
+
+template<typename VertexT>
+BatchClipper<VertexT>::BatchClipper() = default;
+
+template<typename VertexT>
+BatchClipper<VertexT>::BatchClipper(BatchClipper&& other) noexcept = default;
+
+template<typename VertexT>
+BatchClipper<VertexT>& BatchClipper<VertexT>::operator=(BatchClipper&& other) noexcept = default;
+
+template<typename VertexT>
+BatchClipper<VertexT>::~BatchClipper() = default;
+
+template<typename VertexT>
+void BatchClipper<VertexT>::clear()
+{
+	groupCount = 0;
+	openGroups[0] = openGroups[1] = SIZE_MAX;
+	polygonSlots.clear();
+}
+
+template<typename VertexT>
+void BatchClipper<VertexT>::add(const TriangleT<VertexT>& triangle, const uint32_t planes)
+{
+	size_t& open = openGroups[(planes & ~(CLIP_Z_POSITIVE | CLIP_Z_NEGATIVE)) != 0 ? 1 : 0];
+	if (open == SIZE_MAX || groups[open].lanes == simd::WIDTH)
+	{
+		open = groupCount++;
+		if (groups.size() < groupCount)
+		{
+			groups.resize(groupCount);
+		}
+		Group& group = groups[open];
+		std::fill_n(group.counts, simd::WIDTH, 0u);
+		std::fill_n(group.planes, simd::WIDTH, 0u);
+		group.current = 0;
+		group.lanes = 0;
+	}
+	Group& target = groups[open];
+	const int lane = target.lanes++;
+	for (int j = 0; j < 3; j++)
+	{
+		const VertexT& vertex = triangle.vertices[j];
+		float(&channels)[CHANNELS][simd::WIDTH] = target.vertices[0][j];
+		channels[0][lane] = vertex.position.x;
+		channels[1][lane] = vertex.position.y;
+		channels[2][lane] = vertex.position.z;
+		channels[3][lane] = vertex.position.w;
+		const float* varyings = VertexT::Layout::data(vertex.varyings);
+		for (int c = 4; c < CHANNELS; c++)
+		{
+			channels[c][lane] = varyings[c - 4];
+		}
+	}
+	target.counts[lane] = 3;
+	target.planes[lane] = planes;
+	polygonSlots.push_back(static_cast<uint32_t>(open * simd::WIDTH + lane));
+}
+
+template<int CHANNELS>
+using GroupVertices = float[MAX_POINTS][CHANNELS][simd::WIDTH];
+
+// signed distance of the lanes' vertices to the plane, inside when >= 0 (Clipper::isInBoundary)
+template<int AXIS, bool W_SIGN>
+simd::VFloat planeDistance(const simd::VFloat* v)
+{
+	return W_SIGN ? v[CHANNEL_W] - v[AXIS] : v[CHANNEL_W] + v[AXIS];
+}
+
+// the pass when every lane holds a triangle (or nothing): the polygon is the vertex alone on its side of the plane
+// and the two intersections of its edges, or the other two vertices and those intersections. the lanes are rotated
+// so that vertex comes first, then every output slot is a select, no lane writes anywhere of its own
+template<int AXIS, bool W_SIGN, int CHANNELS>
+void clipTrianglesWithPlane(const GroupVertices<CHANNELS>& in, GroupVertices<CHANNELS>& out, uint32_t* counts, const simd::VInt active)
+{
+	using namespace simd;
+
+	VFloat v[3][CHANNELS];
+	for (int j = 0; j < 3; j++)
+	{
+		for (int c = 0; c < CHANNELS; c++)
+		{
+			v[j][c] = load(in[j][c]);
+		}
+	}
+	const VFloat zero = set1(0.0f);
+	// lanes not crossing the plane are inside it
+	const VInt inside0 = andNot(set1(-1), active & (planeDistance<AXIS, W_SIGN>(v[0]) < zero));
+	const VInt inside1 = andNot(set1(-1), active & (planeDistance<AXIS, W_SIGN>(v[1]) < zero));
+	const VInt inside2 = andNot(set1(-1), active & (planeDistance<AXIS, W_SIGN>(v[2]) < zero));
+	const VInt allInside = inside0 & inside1 & inside2;
+	const VInt noneInside = andNot(andNot(andNot(set1(-1), inside0), inside1), inside2);
+	const VInt odd1 = (inside1 ^ inside0) & (inside1 ^ inside2);
+	const VInt odd2 = (inside2 ^ inside0) & (inside2 ^ inside1);
+
+	// r0: the odd vertex, r1 and r2 the next ones in winding order
+	VFloat r[3][CHANNELS];
+	for (int c = 0; c < CHANNELS; c++)
+	{
+		r[0][c] = select(odd1, v[1][c], select(odd2, v[2][c], v[0][c]));
+		r[1][c] = select(odd1, v[2][c], select(odd2, v[0][c], v[1][c]));
+		r[2][c] = select(odd1, v[0][c], select(odd2, v[1][c], v[2][c]));
+	}
+	const VInt oddInside = select(odd1, inside1, select(odd2, inside2, inside0));
+	const VFloat distance0 = planeDistance<AXIS, W_SIGN>(r[0]), distance1 = planeDistance<AXIS, W_SIGN>(r[1]);
+	const VFloat distance2 = planeDistance<AXIS, W_SIGN>(r[2]);
+	// edges r0 -> r1 and r2 -> r0, interpolated from their first vertex as Clipper::computeParamT
+	const VFloat t01 = distance0 / (distance0 - distance1), t20 = distance2 / (distance2 - distance0);
+	for (int c = 0; c < CHANNELS; c++)
+	{
+		const VFloat intersection01 = r[0][c] + (r[1][c] - r[0][c]) * t01;
+		const VFloat intersection20 = r[2][c] + (r[0][c] - r[2][c]) * t20;
+		store(out[0][c], select(allInside, v[0][c], select(oddInside, r[0][c], intersection01)));
+		store(out[1][c], select(allInside, v[1][c], select(oddInside, intersection01, r[1][c])));
+		store(out[2][c], select(allInside, v[2][c], select(oddInside, intersection20, r[2][c])));
+		store(out[3][c], intersection20);
+	}
+
+	const VInt count = select(allInside, set1(3), select(oddInside, set1(3), set1(4)));
+	store(counts, select(noneInside | (load(counts) == set1(0)), set1(0), count));
+}
+
+// one Sutherland-Hodgman pass of every lane crossing the plane. the lanes step through their polygons together,
+// vertex k of every lane per step, and each writes its output vertices at its own count
+template<int AXIS, bool W_SIGN, int CHANNELS>
+void clipPolygonsWithPlane(const GroupVertices<CHANNELS>& in, GroupVertices<CHANNELS>& out, uint32_t* counts, const simd::VInt active)
+{
+	using namespace simd;
+
+	const VInt one = set1(1);
+	const VInt inCount = load(counts);
+	const uint32_t maxCount = *std::max_element(counts, counts + WIDTH);
+	VInt outCount = set1(0);
+
+	const auto write = [&](const VInt mask, const VFloat* v)
+	{
+		const int lanes = moveMask(mask);
+		if (lanes == 0)
+		{
+			return;
+		}
+		// no scatter store below AVX-512: the lanes' vertices go to their slots one by one
+		alignas(64) float values[CHANNELS][WIDTH];
+		alignas(64) uint32_t slots[WIDTH];
+		for (int c = 0; c < CHANNELS; c++)
+		{
+			store(values[c], v[c]);
+		}
+		store(slots, outCount);
+		for (int lane = 0; lane < WIDTH; lane++)
+		{
+			if ((lanes & (1 << lane)) == 0)
+			{
+				continue;
+			}
+			for (int c = 0; c < CHANNELS; c++)
+			{
+				out[slots[lane]][c][lane] = values[c][lane];
+			}
+		}
+		outCount = outCount + (mask & one);
+	};
+
+	for (uint32_t k = 0; k < maxCount; k++)
+	{
+		// B is vertex k + 1, vertex 0 for the last vertex of a lane
+		const VInt valid = inCount > set1(static_cast<int32_t>(k));
+		const VInt wraps = andNot(set1(-1), inCount > set1(static_cast<int32_t>(k + 1)));
+		VFloat a[CHANNELS], b[CHANNELS];
+		for (int c = 0; c < CHANNELS; c++)
+		{
+			a[c] = load(in[k][c]);
+			b[c] = select(wraps, load(in[0][c]), load(in[k + 1][c]));
+		}
+		const VFloat distanceA = planeDistance<AXIS, W_SIGN>(a), distanceB = planeDistance<AXIS, W_SIGN>(b);
+		// lanes not crossing the plane keep every vertex
+		const VInt outsideA = active & (distanceA < set1(0.0f)), outsideB = active & (distanceB < set1(0.0f));
+
+		write(andNot(valid, outsideA), a);
+
+		const VInt crossing = valid & (outsideA ^ outsideB);
+		if (moveMask(crossing) != 0)
+		{
+			const VFloat t = distanceA / (distanceA - distanceB);
+			VFloat intersection[CHANNELS];
+			for (int c = 0; c < CHANNELS; c++)
+			{
+				intersection[c] = a[c] + (b[c] - a[c]) * t;
+			}
+			write(crossing, intersection);
+		}
+	}
+
+	store(counts, outCount);
+}
+
+// the pass of one plane over a group, skipped when no lane crosses the plane. guardBand: x / y are only clipped
+// while a vertex is outside guardBand * w, as in Clipper::clipPlanes but for the polygon left by the earlier passes
+template<int AXIS, bool W_SIGN, int CHANNELS>
+void clipGroupWithPlane(GroupVertices<CHANNELS> (&vertices)[2], uint32_t* counts, const uint32_t* planes, int& current, const float guardBand = 1.0f)
+{
+	using namespace simd;
+
+	const VInt zero = set1(0);
+	const VInt active = andNot(set1(-1), (load(planes) & set1(static_cast<int32_t>(Clipper<VertexP>::template planeBit<AXIS, W_SIGN>()))) == zero);
+	if (moveMask(active) == 0)
+	{
+		return;
+	}
+
+	// an earlier pass may have cut away every vertex outside this plane, near / far go first for that: the part
+	// behind the camera is what usually puts a vertex outside the x / y planes and the guard band
+	const VInt inCount = load(counts);
+	const uint32_t maxCount = *std::max_element(counts, counts + WIDTH);
+	const VFloat guard = set1(guardBand);
+	VInt outside = zero;
+	for (uint32_t k = 0; k < maxCount; k++)
+	{
+		const VFloat axis = load(vertices[current][k][AXIS]), w = guard * load(vertices[current][k][CHANNEL_W]);
+		outside = outside | ((inCount > set1(static_cast<int32_t>(k))) & ((W_SIGN ? w - axis : w + axis) < set1(0.0f)));
+	}
+	// per lane: a polygon inside the guard band is carried over as it is whatever the other lanes of its group, the
+	// clipping of a triangle never depends on its neighbours in the batch
+	const VInt clipped = active & outside;
+	if (moveMask(clipped) == 0)
+	{
+		return;
+	}
+
+	if (moveMask((inCount == set1(3)) | (inCount == zero)) == (1 << WIDTH) - 1)
+	{
+		clipTrianglesWithPlane<AXIS, W_SIGN, CHANNELS>(vertices[current], vertices[1 - current], counts, clipped);
+	}
+	else
+	{
+		clipPolygonsWithPlane<AXIS, W_SIGN, CHANNELS>(vertices[current], vertices[1 - current], counts, clipped);
+	}
+	current = 1 - current;
+}
+
+template<typename VertexT>
+void BatchClipper<VertexT>::clip(const glm::vec2& guardBand)
+{
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		Group& target = groups[group];
+		using C = Clipper<VertexT>;
+		clipGroupWithPlane<C::Z, C::NEGATIVE>(target.vertices, target.counts, target.planes, target.current);
+		clipGroupWithPlane<C::Z, C::POSITIVE>(target.vertices, target.counts, target.planes, target.current);
+		clipGroupWithPlane<C::X, C::POSITIVE>(target.vertices, target.counts, target.planes, target.current, guardBand.x);
+		clipGroupWithPlane<C::X, C::NEGATIVE>(target.vertices, target.counts, target.planes, target.current, guardBand.x);
+		clipGroupWithPlane<C::Y, C::POSITIVE>(target.vertices, target.counts, target.planes, target.current, guardBand.y);
+		clipGroupWithPlane<C::Y, C::NEGATIVE>(target.vertices, target.counts, target.planes, target.current, guardBand.y);
+	}
+}
+
+template<typename VertexT>
+size_t BatchClipper<VertexT>::getPolygon(const size_t polygon, VertexT* vertices) const
+{
+	const Group& source = groups[polygonSlots[polygon] / simd::WIDTH];
+	const size_t lane = polygonSlots[polygon] % simd::WIDTH;
+	const size_t vertexCount = source.counts[lane];
+	for (size_t j = 0; j < vertexCount; j++)
+	{
+		const float(&channels)[CHANNELS][simd::WIDTH] = source.vertices[source.current][j];
+		vertices[j].position = glm::vec4(channels[0][lane], channels[1][lane], channels[2][lane], channels[3][lane]);
+		float* varyings = VertexT::Layout::data(vertices[j].varyings);
+		for (int c = 4; c < CHANNELS; c++)
+		{
+			varyings[c - 4] = channels[c][lane];
+		}
+	}
+	return vertexCount;
+}
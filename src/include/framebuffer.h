@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "alignedbuffer.h"
+
+// packed 8 bit per channel color, R in the lowest byte (GL_RGBA / GL_UNSIGNED_BYTE in memory)
+inline uint32_t packRGBA8(const glm::vec3& color)
+{
+	const glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f;
+	return static_cast<uint32_t>(c.r) |
+		   static_cast<uint32_t>(c.g) << 8 |
+		   static_cast<uint32_t>(c.b) << 16 |
+		   0xff000000u;
+}
+
+inline glm::vec3 unpackRGBA8(const uint32_t color)
+{
+	return glm::vec3(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff) / 255.0f;
+}
+
+enum class FrameBufferLayout { LINEAR, TILED };
+
+class JobSystem;
+
+// pixel (x, y) -> element index, row major
+struct LinearAddressing
+{
+	int pitch;
+
+	size_t operator()(int x, int y) const
+	{
+		return static_cast<size_t>(y) * pitch + x;
+	}
+};
+
+// pixel (x, y) -> element index, row major tiles of (1 << shift)^2 pixels, row major inside a tile
+struct TiledAddressing
+{
+	int shift;
+	int tilesX;
+
+	size_t operator()(int x, int y) const
+	{
+		const int mask = (1 << shift) - 1;
+		const size_t tile = static_cast<size_t>(y >> shift) * tilesX + (x >> shift);
+		return (tile << (2 * shift)) + ((y & mask) << shift) + (x & mask);
+	}
+};
+
+// depth (32 bit float) and color (RGBA8) attachments, each a single aligned allocation.
+// LINEAR: rows padded to PITCH_ALIGNMENT pixels so every row starts on a cache line.
+// TILED: square tiles stored contiguously so a small triangle touches few cache lines and pages,
+// width and height padded to whole tiles.
+// hi-Z: the farthest depth of every HI_Z_BLOCK_SIZE^2 pixels block, row major, never nearer than the depths of its
+// block: the rasterizer skips the blocks and triangles behind it. kept by the rasterizer and clear, a depth written
+// through depthData() must not be farther than the hi-Z of its block.
+// fast clear: clear writes no pixel, it flags every CLEAR_BLOCK_SIZE^2 block as cleared, one bit per block and one
+// 64 bit word per CLEAR_TILE_SIZE^2 tile. the rasterizer writes the clear values into a block the first time it
+// touches it, the resolves output the clear color of the blocks never touched. depthData() / colorData() hold the
+// pending blocks' old contents until resolveClear
+class FrameBuffer
+{
+public:
+	static constexpr int PITCH_ALIGNMENT = 16;
+	static constexpr int DEFAULT_TILE_SIZE = 8;
+	// the rasterizer writes rows of 8 pixels with one vector store, tiles must be at least that wide
+	static constexpr int MIN_TILE_SIZE = 8;
+	// the raster blocks of the rasterizer
+	static constexpr int HI_Z_BLOCK_SIZE = 8;
+	static constexpr int CLEAR_BLOCK_SIZE = 8;
+	static constexpr int CLEAR_TILE_SIZE = 64;
+	static constexpr int CLEAR_TILE_BLOCKS = CLEAR_TILE_SIZE / CLEAR_BLOCK_SIZE;
+	static_assert(CLEAR_TILE_BLOCKS * CLEAR_TILE_BLOCKS == 64, "one 64 bit word of clear flags per tile");
+	// depth of a resized frame buffer, farther than any window depth
+	static constexpr float DEFAULT_CLEAR_DEPTH = 2.0f;
+
+	// count: the pixels of the block at the farthest depth. depths only get nearer, so the farthest one stays until
+	// the rasterizer has overwritten them all and rescans the block
+	struct HiZBlock
+	{
+		float farthest;
+		int count;
+	};
+
+	FrameBuffer() = default;
+	FrameBuffer(int width, int height, FrameBufferLayout layout = FrameBufferLayout::LINEAR, int tileSize = DEFAULT_TILE_SIZE)
+	{
+		resize(width, height, layout, tileSize);
+	}
+
+	// tileSize is rounded up to a power of two no smaller than MIN_TILE_SIZE, ignored for LINEAR. the attachments are
+	// left as after clear(DEFAULT_CLEAR_DEPTH, black), hi-Z included
+	void resize(int width, int height, FrameBufferLayout layout = FrameBufferLayout::LINEAR, int tileSize = DEFAULT_TILE_SIZE);
+	// O(tiles): flags every block as cleared, and resets the hi-Z blocks
+	void clear(float depth, const glm::vec3& color);
+	// writes the pending clear of the blocks the rasterizer has not touched, for direct access to the attachments
+	void resolveClear();
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	int getPitch() const { return m_pitch; }
+	FrameBufferLayout getLayout() const { return m_layout; }
+	int getTileSize() const { return 1 << m_tileShift; }
+
+	LinearAddressing linearAddressing() const { return { m_pitch }; }
+	TiledAddressing tiledAddressing() const { return { m_tileShift, m_pitch >> m_tileShift }; }
+
+	size_t offset(int x, int y) const
+	{
+		return m_layout == FrameBufferLayout::TILED ? tiledAddressing()(x, y) : linearAddressing()(x, y);
+	}
+
+	float* depthData() { return m_depth.data(); }
+	const float* depthData() const { return m_depth.data(); }
+	uint32_t* colorData() { return m_color.data(); }
+	const uint32_t* colorData() const { return m_color.data(); }
+
+	// nullptr when disabled: the rasterizer neither tests nor updates it, depths only get nearer meanwhile so the
+	// blocks stay valid for enabling it again
+	HiZBlock* hiZData() { return m_hiZEnabled ? m_hiZ.data() : nullptr; }
+	int getHiZPitch() const { return m_hiZPitch; }
+	void setHiZEnabled(bool enabled) { m_hiZEnabled = enabled; }
+	bool isHiZEnabled() const { return m_hiZEnabled; }
+
+	// tile (x / CLEAR_TILE_SIZE, y / CLEAR_TILE_SIZE) is word tileY * getClearPitch() + tileX, the block of pixel
+	// (x, y) in it bit clearBit(x, y)
+	uint64_t* clearFlags() { return m_clearFlags.data(); }
+	const uint64_t* clearFlags() const { return m_clearFlags.data(); }
+	int getClearPitch() const { return m_clearPitch; }
+	float getClearDepth() const { return m_clearDepth; }
+	uint32_t getClearColor() const { return m_clearColor; }
+	static uint64_t clearBit(int x, int y)
+	{
+		const int blockX = (x % CLEAR_TILE_SIZE) / CLEAR_BLOCK_SIZE, blockY = (y % CLEAR_TILE_SIZE) / CLEAR_BLOCK_SIZE;
+		return uint64_t(1) << (blockY * CLEAR_TILE_BLOCKS + blockX);
+	}
+	bool isCleared(int x, int y) const
+	{
+		return (m_clearFlags[static_cast<size_t>(y / CLEAR_TILE_SIZE) * m_clearPitch + x / CLEAR_TILE_SIZE] & clearBit(x, y)) != 0;
+	}
+
+	// the attachments as they are in memory, see resolveClear
+	float& depth(int x, int y) { return m_depth[offset(x, y)]; }
+	uint32_t& color(int x, int y) { return m_color[offset(x, y)]; }
+
+	// copy color into tightly packed linear rows, bottom row first. jobSystem: convert bands of rows in parallel
+	void resolveRGBA8(uint8_t* dst, JobSystem* jobSystem = nullptr) const;
+	void resolveBGR8(uint8_t* dst, JobSystem* jobSystem = nullptr) const;
+
+private:
+	int m_width = 0, m_height = 0, m_pitch = 0;
+	FrameBufferLayout m_layout = FrameBufferLayout::LINEAR;
+	int m_tileShift = 3;
+	AlignedBuffer<float> m_depth;
+	AlignedBuffer<uint32_t> m_color;
+	int m_hiZPitch = 0;
+	bool m_hiZEnabled = true;
+	AlignedBuffer<HiZBlock> m_hiZ;
+	int m_clearPitch = 0;
+	float m_clearDepth = 0.0f;
+	uint32_t m_clearColor = 0;
+	AlignedBuffer<uint64_t> m_clearFlags;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// ======== JobSystem ========
+
+// per worker counters since the last JobSystem::resetStats
+struct WorkerStats
+{
+	uint64_t jobs = 0;
+	// jobs taken from another worker's deque
+	uint64_t steals = 0;
+	double busyMs = 0;
+	// time not spent running jobs
+	double idleMs = 0;
+};
+
+// work-stealing scheduler. every worker owns a deque of jobs: it pushes and pops at the back (depth first, cache warm)
+// and, when its own deque is empty, steals from the front of another one (the biggest, oldest pieces of work).
+// the thread that creates the JobSystem is worker 0 and runs jobs while it waits, so a system of one thread runs
+// everything inline. jobs are submitted from the creating thread or from inside jobs.
+class JobSystem
+{
+public:
+	// counts the unfinished jobs of a fork / join group
+	class Counter
+	{
+		friend class JobSystem;
+		std::atomic<int> pending{ 0 };
+	};
+
+	// threads: workers including the creating thread, 0 for std::thread::hardware_concurrency().
+	// pinThreads: bind worker i to logical cpu i modulo the cpu count (linux and windows, ignored elsewhere)
+	explicit JobSystem(int threads = 0, bool pinThreads = false);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	int getThreadCount() const { return threadCount; }
+	// worker index of the calling thread, 0 outside the workers
+	int currentWorker() const;
+
+	// queues fn() counted by counter. fn is referenced, not copied: it must live until wait(counter) returns
+	template<typename Fn>
+	void spawn(Counter& counter, const Fn& fn)
+	{
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		push(Job{ &runFunction<Fn>, &fn, 0, 0, &counter });
+	}
+
+	// runs queued jobs until every job of counter is done
+	void wait(Counter& counter);
+
+	// fork / join: a and b in parallel, returns when both are done
+	template<typename A, typename B>
+	void invoke(const A& a, const B& b)
+	{
+		Counter counter;
+		spawn(counter, b);
+		a();
+		wait(counter);
+	}
+
+	// body(begin, end, worker) over disjoint pieces of [begin, end) of at most grain items. the range is split
+	// in halves and the upper halves are queued, so idle workers steal the largest remaining pieces
+	template<typename Body>
+	void parallelFor(size_t begin, size_t end, size_t grain, const Body& body)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+		Counter counter;
+		counter.pending.store(1, std::memory_order_relaxed);
+		const Range<Body> range = { &body, grain > 0 ? grain : 1 };
+		execute(Job{ &runRange<Body>, &range, begin, end, &counter }, currentWorker(), false);
+		wait(counter);
+	}
+
+	std::vector<WorkerStats> getStats() const;
+	void resetStats();
+
+private:
+	struct Job
+	{
+		void (*run)(JobSystem& system, const Job& job, int worker);
+		const void* context;
+		size_t begin, end;
+		Counter* counter;
+	};
+
+	template<typename Body>
+	struct Range
+	{
+		const Body* body;
+		size_t grain;
+	};
+
+	template<typename Fn>
+	static void runFunction(JobSystem&, const Job& job, int)
+	{
+		(*static_cast<const Fn*>(job.context))();
+	}
+
+	template<typename Body>
+	static void runRange(JobSystem& system, const Job& job, int worker)
+	{
+		const Range<Body>& range = *static_cast<const Range<Body>*>(job.context);
+		size_t begin = job.begin, end = job.end;
+		while (end - begin > range.grain)
+		{
+			const size_t middle = begin + (end - begin) / 2;
+			job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+			system.push(Job{ job.run, job.context, middle, end, job.counter });
+			end = middle;
+		}
+		(*range.body)(begin, end, worker);
+	}
+
+	// growable ring buffer, the owner works at the back, thieves at the front
+	struct alignas(64) WorkerQueue
+	{
+		std::mutex mutex;
+		std::vector<Job> jobs;
+		size_t head = 0, count = 0;
+	};
+
+	struct alignas(64) WorkerCounters
+	{
+		std::atomic<uint64_t> jobs{ 0 };
+		std::atomic<uint64_t> steals{ 0 };
+		std::atomic<int64_t> busyNs{ 0 };
+	};
+
+	void push(const Job& job);
+	bool pop(int worker, Job& job);
+	bool steal(int worker, Job& job);
+	void execute(const Job& job, int worker, bool stolen);
+	void workerLoop(int worker);
+
+	int threadCount;
+	bool pinThreads;
+	std::unique_ptr<WorkerQueue[]> queues;
+	std::unique_ptr<WorkerCounters[]> counters;
+	std::vector<std::thread> threads;
+
+	// idle workers sleep until jobs are queued
+	std::atomic<int> queuedJobs{ 0 };
+	std::atomic<int> sleepers{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool quit = false;
+
+	std::chrono::steady_clock::time_point statsStart;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+// ======== Mesh ========
+
+// indexed triangle mesh: a vertex buffer and three indices per triangle, so a vertex shared by several
+// triangles is stored and transformed once. positions are kept as separate x, y, z arrays, the layout
+// of the SoA transform kernel. normals and uvs are optional, empty or one per vertex.
+struct Mesh
+{
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<uint32_t> indices;
+
+	size_t getVertexCount() const { return colors.size(); }
+	size_t getTriangleCount() const { return indices.size() / 3; }
+
+	uint32_t addVertex(const Vertex& vertex);
+	void addTriangle(uint32_t a, uint32_t b, uint32_t c);
+	Vertex getVertex(uint32_t index) const;
+};
+
+// axis aligned box, empty (min > max) when made of no point
+struct Bounds
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+// model space bounds of the mesh's vertices
+Bounds computeBounds(const Mesh& mesh);
+
+// post-transform cache entries the reordering optimizes for, the FIFO cache of the stream renderer's mesh batches
+static constexpr int VERTEX_CACHE_SIZE = 32;
+
+// average cache miss ratio: vertices transformed per triangle when the indices go through a FIFO post-transform
+// cache of cacheSize entries. 3 without any reuse, about 0.5 - 0.7 for a well ordered closed mesh
+double computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize);
+
+// reorders the triangles for post-transform cache hits (Forsyth, "Linear-speed vertex cache optimisation"):
+// greedily emits the triangle whose vertices score best, favouring recently used vertices and vertices with
+// few triangles left. the winding of every triangle is kept
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
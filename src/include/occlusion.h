@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "alignedbuffer.h"
+#include "mesh.h"
+
+// ======== Occlusion culling ========
+
+// occlusion culling work counters, since the last begin
+struct OcclusionStats
+{
+	// occluder triangles rasterized, and skipped for crossing the near plane
+	size_t occluderTriangles = 0;
+	size_t occluderTrianglesSkipped = 0;
+	// bounds tested by isVisible, and found hidden behind the occluders or outside the view
+	size_t boundsTested = 0;
+	size_t boundsCulled = 0;
+};
+
+// software occlusion culling before the geometry stages: a few large occluder meshes are rasterized into a small
+// depth buffer covering the whole view, then the bounds of every mesh are tested against it and the hidden meshes
+// are not drawn at all. both sides are conservative, so culling never removes a visible pixel:
+//	- an occluder only writes the pixels it covers entirely, with the farthest depth of the triangle over the pixel
+//	- a box is tested on every pixel its screen rectangle touches, with the nearest depth of its corners
+// the depth buffer uses the window depth of the renderer, [0, 1] with nearer smaller, over the same normalized
+// device coordinates as the frame buffer whatever its resolution
+class OcclusionCuller
+{
+public:
+	static constexpr int DEFAULT_WIDTH = 256;
+	static constexpr int DEFAULT_HEIGHT = 128;
+
+	explicit OcclusionCuller(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT);
+
+	// starts a frame: the depth buffer is cleared to the far plane and the stats reset
+	void begin(const glm::mat4& view, const glm::mat4& projection);
+	// the triangles of mesh, both windings. the ones crossing the near plane or reaching far out of the view are skipped
+	void addOccluder(const Mesh& mesh, const glm::mat4& model);
+	// false when the model space bounds are hidden by the occluders added so far, or outside the view
+	bool isVisible(const Bounds& bounds, const glm::mat4& model);
+
+	const OcclusionStats& getStats() const { return m_stats; }
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	int getPitch() const { return m_pitch; }
+	// row major, y = 0 at the bottom of the view as in the frame buffer
+	const float* depthData() const { return m_depth.data(); }
+
+private:
+	void rasterizeOccluder(const glm::vec3* vertices);
+
+	int m_width, m_height, m_pitch;
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);
+	AlignedBuffer<float> m_depth;
+	OcclusionStats m_stats;
+	// clip space positions and outcodes of the current occluder
+	std::vector<float> m_clipX, m_clipY, m_clipZ, m_clipW;
+	std::vector<uint32_t> m_outcodes;
+};
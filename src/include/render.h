@@ -0,0 +1,251 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "framebuffer.h"
+#include "shader.h"
+
+// ======== SoftRender ========
+
+std::array<int, 4> getBBox(const std::array<glm::vec3, 3>& tri, const int width, const int height);
+
+class JobSystem;
+template<typename VertexT>
+class BatchClipper;
+struct Mesh;
+
+// screen coordinates of the geometry output stay within +-MAX_SCREEN_COORDINATE pixels, which keeps the 24.8 fixed
+// point positions and the 64 bit edge functions of the rasterizer exact
+static constexpr int MAX_SCREEN_COORDINATE = 1 << 14;
+
+enum class CullMode { NONE, BACK, FRONT };
+
+// winding of front facing triangles in the y up screen space (normalized device coordinates)
+enum class FrontFace { COUNTER_CLOCKWISE, CLOCKWISE };
+
+struct GeometryOptions
+{
+	// clip against x / y only the triangles reaching outside the guard band (MAX_SCREEN_COORDINATE), the rasterizer
+	// scissors the others to the screen. near / far are always clipped
+	bool guardBand = true;
+	CullMode cullMode = CullMode::NONE;
+	FrontFace frontFace = FrontFace::COUNTER_CLOCKWISE;
+};
+
+// geometry work counters, accumulated over geometryProcess calls
+struct GeometryStats
+{
+	uint64_t triangles = 0;
+	// outside one of the frustum planes with all three vertices
+	uint64_t trivialRejected = 0;
+	// went through polygon clipping
+	uint64_t clipped = 0;
+	// discarded after the screen mapping for their facing, and for covering no area once snapped
+	uint64_t culled = 0;
+	uint64_t degenerate = 0;
+	// screen triangles produced
+	uint64_t output = 0;
+
+	GeometryStats& operator+=(const GeometryStats& other)
+	{
+		triangles += other.triangles;
+		trivialRejected += other.trivialRejected;
+		clipped += other.clipped;
+		culled += other.culled;
+		degenerate += other.degenerate;
+		output += other.output;
+		return *this;
+	}
+};
+
+// one shot GeometryProcessor::process, the buffers are allocated for this call.
+// jobSystem: run the vertex, clip and screen mapping stages in parallel, nullptr for the calling thread only
+void geometryProcess(std::vector<TriangleP>& screenTriangles,
+					const std::vector<Triangle>& triangles,
+					const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+					const int width, const int height, JobSystem* jobSystem = nullptr,
+					const GeometryOptions& options = GeometryOptions(), GeometryStats* stats = nullptr);
+
+// indexed mesh: every vertex is transformed once, the triangles are assembled from the index buffer
+void geometryProcess(std::vector<TriangleP>& screenTriangles,
+					const Mesh& mesh,
+					const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+					const int width, const int height, JobSystem* jobSystem = nullptr,
+					const GeometryOptions& options = GeometryOptions(), GeometryStats* stats = nullptr);
+
+// the geometry stages with their intermediate buffers kept from call to call: once the buffers have grown to a
+// scene, process runs without heap allocations (screenTriangles too, when the caller reuses it). the vertex stage
+// is the fixed function one of GouraudShader, StreamRendererT takes other shaders.
+// jobSystem: run the stages in parallel, nullptr for the calling thread only
+class GeometryProcessor
+{
+public:
+	explicit GeometryProcessor(JobSystem* jobSystem = nullptr);
+	~GeometryProcessor();
+
+	void process(std::vector<TriangleP>& screenTriangles,
+				 const std::vector<Triangle>& triangles,
+				 const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+				 const int width, const int height,
+				 const GeometryOptions& options = GeometryOptions(), GeometryStats* stats = nullptr);
+
+	void process(std::vector<TriangleP>& screenTriangles,
+				 const Mesh& mesh,
+				 const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+				 const int width, const int height,
+				 const GeometryOptions& options = GeometryOptions(), GeometryStats* stats = nullptr);
+
+	// bytes held by the intermediate buffers
+	size_t getBufferBytes() const;
+
+private:
+	template<typename FetchTriangle>
+	void clipAndMapTriangles(std::vector<TriangleP>& screenTriangles, size_t triangleCount, const FetchTriangle& fetchTriangle,
+							 const int width, const int height, const GeometryOptions& options, GeometryStats* stats);
+
+	JobSystem* jobSystem;
+	// clip space triangles of the triangle soup path, clip space vertices of the mesh path
+	std::vector<TriangleP> clipTriangles;
+	std::vector<float> clipX, clipY, clipZ, clipW;
+	std::vector<uint32_t> clipOutcodes;
+	// screen triangles of every input chunk
+	std::vector<std::vector<TriangleP>> clippedChunks;
+	std::vector<GeometryStats> chunkStats;
+	std::vector<size_t> chunkOffsets;
+	std::vector<BatchClipper<VertexP>> clippers;
+};
+
+// raster work counters, accumulated over rasterize calls
+struct RasterStats
+{
+	uint64_t triangles = 0;
+	// 64x64 blocks outside the triangle / fully inside it
+	uint64_t coarseBlocksRejected = 0;
+	uint64_t coarseBlocksAccepted = 0;
+	// 8x8 blocks outside / fully inside / on the border of the triangle
+	uint64_t blocksRejected = 0;
+	uint64_t blocksAccepted = 0;
+	uint64_t blocksPartial = 0;
+	// pixels that went through the per pixel edge test, and pixels inside the triangle (tested or accepted)
+	uint64_t pixelsTested = 0;
+	uint64_t pixelsCovered = 0;
+	// pixels that ran the fragment stage: the covered ones passing early-Z, every covered one for late-Z shaders
+	uint64_t pixelsShaded = 0;
+	// skipped by the hi-Z test, behind the farthest depth of their blocks: small triangles, 64x64 and 8x8 blocks
+	uint64_t trianglesOccluded = 0;
+	uint64_t coarseBlocksOccluded = 0;
+	uint64_t blocksOccluded = 0;
+	// triangle / bin pairs of the binned rasterizer
+	uint64_t binnedTriangles = 0;
+
+	RasterStats& operator+=(const RasterStats& other)
+	{
+		triangles += other.triangles;
+		coarseBlocksRejected += other.coarseBlocksRejected;
+		coarseBlocksAccepted += other.coarseBlocksAccepted;
+		blocksRejected += other.blocksRejected;
+		blocksAccepted += other.blocksAccepted;
+		blocksPartial += other.blocksPartial;
+		pixelsTested += other.pixelsTested;
+		pixelsCovered += other.pixelsCovered;
+		pixelsShaded += other.pixelsShaded;
+		trianglesOccluded += other.trianglesOccluded;
+		coarseBlocksOccluded += other.coarseBlocksOccluded;
+		blocksOccluded += other.blocksOccluded;
+		binnedTriangles += other.binnedTriangles;
+		return *this;
+	}
+};
+
+// the fragment stage is the fixed function one of GouraudShader, as for TileRasterizer.
+// pass: one pass of a Z-prepass (see DepthPass), both passes take the same triangles
+void rasterize(const std::vector<TriangleP>& triangles, FrameBuffer& frameBuffer, RasterStats* stats = nullptr,
+			   DepthPass pass = DepthPass::NORMAL);
+
+template<typename Varyings>
+struct TriangleSetup;
+
+// sort-middle rasterizer: the triangles are set up and sorted into BIN_SIZE x BIN_SIZE screen bins, then the bins
+// are rasterized in parallel. a bin is drawn by a single worker in submission order and no other bin touches its
+// pixels, so depth and color need no locking. the bins keep their storage from frame to frame.
+class TileRasterizer
+{
+public:
+	static constexpr int BIN_SIZE = 64;
+
+	explicit TileRasterizer(JobSystem& jobSystem);
+	~TileRasterizer();
+
+	void rasterize(const std::vector<TriangleP>& triangles, FrameBuffer& frameBuffer, RasterStats* stats = nullptr,
+				   DepthPass pass = DepthPass::NORMAL);
+
+	// bytes held by the setups and bins
+	size_t getBufferBytes() const;
+
+private:
+	JobSystem& jobSystem;
+	// setup of every input triangle, valid for the binned ones
+	std::vector<TriangleSetup<ColorVaryings>> setups;
+	// bins[chunk * binCount + bin]: the triangles of one contiguous input chunk overlapping the bin, in input order
+	std::vector<std::vector<uint32_t>> bins;
+	std::vector<RasterStats> workerStats;
+};
+
+// ======== StreamRenderer ========
+
+// geometry and raster streamed in batches of BATCH_TRIANGLES input triangles: a job transforms, clips, sets up and
+// bins one batch while its triangles are still in cache, then the bins of a window of batches are rasterized in
+// submission order. the intermediate buffers hold one window (a few batches per worker) however large the scene,
+// and are kept from frame to frame. width / height: the screen mapping of the geometry stages.
+// the buffers are laid out for one Varyings layout, draw takes any shader of that layout (see shader.h): its vertex
+// and fragment stages are compiled into the batch and raster loops of that draw. draw is defined in render_impl.h,
+// render.cpp compiles the built-in shaders, a translation unit drawing with a shader of its own includes
+// render_impl.h. Z-prepass: the scene drawn with DepthOnlyShader<Shader>, then again with DepthEqualShader<Shader>
+template<typename Varyings>
+class StreamRendererT
+{
+public:
+	static constexpr size_t BATCH_TRIANGLES = 2048;
+	// batches in flight per worker
+	static constexpr int WINDOW_BATCHES = 4;
+
+	explicit StreamRendererT(JobSystem& jobSystem);
+	~StreamRendererT();
+
+	template<typename Shader>
+	void draw(const std::vector<Triangle>& triangles, const Shader& shader,
+			  const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+			  const int width, const int height, FrameBuffer& frameBuffer,
+			  const GeometryOptions& options = GeometryOptions(), GeometryStats* geometryStats = nullptr, RasterStats* rasterStats = nullptr);
+
+	// indexed mesh: the vertices of a batch are transformed and shaded through a FIFO post-transform cache of
+	// VERTEX_CACHE_SIZE entries, computeACMR of the batch's indices is its vertices per triangle
+	template<typename Shader>
+	void draw(const Mesh& mesh, const Shader& shader,
+			  const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+			  const int width, const int height, FrameBuffer& frameBuffer,
+			  const GeometryOptions& options = GeometryOptions(), GeometryStats* geometryStats = nullptr, RasterStats* rasterStats = nullptr);
+
+	// bytes held by the batch buffers
+	size_t getBufferBytes() const;
+
+private:
+	struct Batch;
+
+	template<typename Shader, typename ProcessBatch>
+	void drawBatches(size_t triangleCount, const Shader& shader, const ProcessBatch& processBatch, FrameBuffer& frameBuffer,
+					 GeometryStats* geometryStats, RasterStats* rasterStats);
+
+	JobSystem& jobSystem;
+	std::vector<Batch> batches;
+	std::vector<RasterStats> workerStats;
+	std::vector<BatchClipper<VertexPT<Varyings>>> clippers;
+};
+
+// the renderer of the fixed function layout, GouraudShader
+using StreamRenderer = StreamRendererT<ColorVaryings>;
@@ -0,0 +1,1124 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "clip.h"
+#include "clip_impl.h"
+#include "render.h"
+#include "simd.h"
+#include "jobsystem.h"
+#include "transform.h"
+#include "mesh.h"
+#include "shader.h"
+
+// ======== SoftRender implementation ========
+
+// the template stages of the pipeline: the geometry of a batch, the triangle setup, binning and the raster loops a
+// shader is compiled into, and StreamRendererT. render.cpp instantiates them for the built-in shaders, a translation
+// unit drawing with a shader of its own includes this header and StreamRendererT::draw is instantiated there
+
+// sub pixel precision of the snapped screen positions (24.8 fixed point)
+static constexpr int SUBPIXEL_BITS = 8;
+static constexpr int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+static constexpr int SUBPIXEL_HALF = SUBPIXEL_ONE / 2;
+
+inline glm::ivec2 snapToSubpixel(const glm::vec4& position)
+{
+	return glm::ivec2(static_cast<int>(std::lround(position.x * SUBPIXEL_ONE)),
+				 static_cast<int>(std::lround(position.y * SUBPIXEL_ONE)));
+}
+
+// the guard band in clip space: |x| <= guardBand.x * w maps to screen x within +-MAX_SCREEN_COORDINATE
+inline glm::vec2 getGuardBand(const int width, const int height)
+{
+	return glm::vec2(2.0f * MAX_SCREEN_COORDINATE / std::max(width, 1) - 1.0f, 2.0f * MAX_SCREEN_COORDINATE / std::max(height, 1) - 1.0f);
+}
+
+// twice the signed area of the snapped triangle in fixed point, positive for counter-clockwise triangles in the
+// y up screen space. the same snapping as the rasterizer setup, so a culled triangle would have drawn nothing
+// of the other facing
+template<typename VertexT>
+int64_t getSnappedArea(const TriangleT<VertexT>& triangle)
+{
+	const glm::ivec2 a = snapToSubpixel(triangle.vertices[0].position);
+	const glm::ivec2 b = snapToSubpixel(triangle.vertices[1].position);
+	const glm::ivec2 c = snapToSubpixel(triangle.vertices[2].position);
+	return static_cast<int64_t>(b.x - a.x) * (c.y - a.y) - static_cast<int64_t>(b.y - a.y) * (c.x - a.x);
+}
+
+// whether the options discard a triangle of this signed area
+inline bool isCulled(const int64_t area, const GeometryOptions& options)
+{
+	if (options.cullMode == CullMode::NONE)
+	{
+		return false;
+	}
+	const bool isFront = options.frontFace == FrontFace::COUNTER_CLOCKWISE ? area > 0 : area < 0;
+	return isFront == (options.cullMode == CullMode::FRONT);
+}
+
+// triangles per classify / clip step of the geometry stages
+static constexpr size_t CLIP_BATCH = 256;
+
+// vertex process2 and 3 of clip space triangles [begin, end): fetchTriangle(i, outcodes) returns triangle i and writes
+// the outcodes of its three vertices, the visible screen triangles are appended to screenTriangles in input order
+template<typename VertexT, typename FetchTriangle>
+void clipAndMapRange(const FetchTriangle& fetchTriangle, const size_t begin, const size_t end, const int width, const int height,
+							const GeometryOptions& options, BatchClipper<VertexT>& clipper, std::vector<TriangleT<VertexT>>& screenTriangles,
+							GeometryStats& stats)
+{
+	// vertex process3: clipSpace -> NDC and NDC -> ScreenSpace, then the fan triangles of the polygon
+	const auto mapPolygon = [&](VertexT* vertices, const size_t verticesCount)
+	{
+		for (size_t j = 0; j < verticesCount; j++)
+		{
+			// projection division
+			glm::vec3 position = glm::vec3(vertices[j].position.x, vertices[j].position.y, vertices[j].position.z) / vertices[j].position.w;
+
+			// screen mapping
+			position = (position + glm::vec3(1.0, 1.0, 1.0)) * glm::vec3(width, height, 1) / 2.0f;
+
+			vertices[j].position = glm::vec4(position, -vertices[j].position.w);
+		}
+
+		// culling: the fan triangles of a clipped polygon all have the facing of the input triangle
+		for(size_t j = 1; j + 1 < verticesCount; j++)
+		{
+			const TriangleT<VertexT> screenTriangle = { { vertices[0], vertices[j], vertices[j + 1] } };
+			const int64_t area = getSnappedArea(screenTriangle);
+			if (area == 0)
+			{
+				stats.degenerate++;
+			}
+			else if (isCulled(area, options))
+			{
+				stats.culled++;
+			}
+			else
+			{
+				screenTriangles.push_back(screenTriangle);
+			}
+		}
+	};
+
+	const glm::vec2 guardBand = options.guardBand ? getGuardBand(width, height) : glm::vec2(1.0f);
+	std::array<TriangleT<VertexT>, CLIP_BATCH> clipTriangles;
+	alignas(64) uint32_t outcodes[3][CLIP_BATCH];
+	alignas(64) uint32_t planes[CLIP_BATCH];
+	for (size_t batchBegin = begin; batchBegin < end; batchBegin += CLIP_BATCH)
+	{
+		const size_t count = std::min(end - batchBegin, CLIP_BATCH);
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t triangleOutcodes[3];
+			clipTriangles[i] = fetchTriangle(batchBegin + i, triangleOutcodes);
+			outcodes[0][i] = triangleOutcodes[0];
+			outcodes[1][i] = triangleOutcodes[1];
+			outcodes[2][i] = triangleOutcodes[2];
+		}
+
+		// vertex process2: clipping in clipSpace, only the triangles crossing a plane go through the clipper
+		classifyTriangles(outcodes[0], outcodes[1], outcodes[2], count, options.guardBand, planes);
+		clipper.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (planes[i] != 0 && planes[i] != CLIP_REJECT)
+			{
+				clipper.add(clipTriangles[i], planes[i]);
+			}
+		}
+		clipper.clip(guardBand);
+
+		size_t polygon = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			std::array<VertexT, BatchClipper<VertexT>::MAX_OUTPUT_CLIPPED_POINT> clipVertices;
+			if (planes[i] == CLIP_REJECT)
+			{
+				stats.trivialRejected++;
+			}
+			else if (planes[i] == 0)
+			{
+				assignData<VertexT>(&clipVertices[0], &clipTriangles[i].vertices[0], 3);
+				mapPolygon(&clipVertices[0], 3);
+			}
+			else
+			{
+				stats.clipped++;
+				mapPolygon(&clipVertices[0], clipper.getPolygon(polygon++, &clipVertices[0]));
+			}
+		}
+	}
+}
+
+// vertex shader input of a triangle soup vertex
+inline VertexAttributes getAttributes(const Vertex& vertex)
+{
+	return { vertex.position, vertex.color, glm::vec3(0.0f), glm::vec2(0.0f) };
+}
+
+// vertex shader input of mesh vertex index, the loads of the attributes a shader does not read are optimized away
+inline VertexAttributes getAttributes(const Mesh& mesh, const uint32_t index)
+{
+	return {
+		glm::vec3(mesh.positionX[index], mesh.positionY[index], mesh.positionZ[index]),
+		mesh.colors[index],
+		mesh.normals.empty() ? glm::vec3(0.0f) : mesh.normals[index],
+		mesh.uvs.empty() ? glm::vec2(0.0f) : mesh.uvs[index],
+	};
+}
+
+// vertex process1 of triangles [begin, end) of a triangle soup: modelSpace -> clipSpace through the SoA transform
+// kernel in batches of whole triangles, the varyings from the vertex stage of the shader. triangle i goes to
+// clipTriangles[i - begin], its outcodes to outcodes[3 * (i - begin)]
+template<typename Shader>
+void transformTriangles(const std::vector<Triangle>& triangles, const size_t begin, const size_t end, const glm::mat4& mvp, const glm::vec2& guardBand,
+							   const Shader& shader, TrianglePT<typename Shader::Varyings>* clipTriangles, uint32_t* outcodes)
+{
+	alignas(64) float x[TRANSFORM_BATCH], y[TRANSFORM_BATCH], z[TRANSFORM_BATCH];
+	alignas(64) float clipX[TRANSFORM_BATCH], clipY[TRANSFORM_BATCH], clipZ[TRANSFORM_BATCH], clipW[TRANSFORM_BATCH];
+	for (size_t batchBegin = begin; batchBegin < end; batchBegin += TRANSFORM_BATCH / 3)
+	{
+		const size_t batchEnd = std::min(end, batchBegin + TRANSFORM_BATCH / 3);
+		size_t count = 0;
+		for (size_t i = batchBegin; i < batchEnd; i++)
+		{
+			for (const Vertex& vertex : triangles[i].vertices)
+			{
+				x[count] = vertex.position.x;
+				y[count] = vertex.position.y;
+				z[count] = vertex.position.z;
+				count++;
+			}
+		}
+
+		// process in vertex shader
+		transformPositions(mvp, x, y, z, count, clipX, clipY, clipZ, clipW, &outcodes[3 * (batchBegin - begin)], guardBand);
+
+		count = 0;
+		for (size_t i = batchBegin; i < batchEnd; i++)
+		{
+			for(size_t j =0; j < 3; j++, count++)
+			{
+				// vertex stage of the shader
+				clipTriangles[i - begin].vertices[j].position = glm::vec4(clipX[count], clipY[count], clipZ[count], clipW[count]);
+				clipTriangles[i - begin].vertices[j].varyings = shader.vertex(getAttributes(triangles[i].vertices[j]));
+			}
+		}
+	}
+}
+
+// edge function of the directed edge a -> b in fixed point: E(x, y) = A * (x - a.x) + B * (y - a.y),
+// twice the signed area of the triangle (a, b, (x, y)) in 1/2^16 pixel units, exact in 64 bit
+struct EdgeFunction
+{
+	int64_t A, B;
+	glm::ivec2 origin;
+	// -1 for edges that do not own the pixels exactly on them
+	int64_t bias = 0;
+
+	EdgeFunction() : A(0), B(0), origin(0) {}
+	EdgeFunction(const glm::ivec2& a, const glm::ivec2& b) : A(a.y - b.y), B(b.x - a.x), origin(a) {}
+
+	int64_t operator()(int64_t x, int64_t y) const { return A * (x - origin.x) + B * (y - origin.y) + bias; }
+
+	// top-left fill rule, for positive area (counter-clockwise in the y up screen space) triangles:
+	// left edges run downwards, top edges are horizontal and run leftwards
+	void applyFillRule()
+	{
+		const bool isTopLeft = A > 0 || (A == 0 && B < 0);
+		bias = isTopLeft ? 0 : -1;
+	}
+
+	void flip()
+	{
+		A = -A;
+		B = -B;
+	}
+};
+
+// pixels per side of the blocks the raster loop walks, every block row is BLOCK_SIZE / simd::WIDTH vectors
+static constexpr int BLOCK_SIZE = 8;
+static_assert(FrameBuffer::HI_Z_BLOCK_SIZE == BLOCK_SIZE, "the hi-Z blocks are the raster blocks");
+static_assert(FrameBuffer::CLEAR_BLOCK_SIZE == BLOCK_SIZE, "the clear blocks are the raster blocks");
+
+inline int64_t floorDiv(int64_t a, int64_t b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// pixels per side of the coarse blocks, rejected or accepted as a whole before looking at their 8x8 blocks
+static constexpr int COARSE_BLOCK_SIZE = 64;
+
+enum class BlockCoverage { OUTSIDE, PARTIAL, INSIDE };
+
+// relative float rounding of the depth the block kernel interpolates, per unit of barycentric magnitude
+static constexpr float DEPTH_ROUNDING = 1e-6f;
+
+// per triangle constants of the block kernel, the varyings aside
+struct TriangleSetupBase
+{
+	std::array<EdgeFunction, 3> edges;
+	double invArea;
+	// barycentric steps per pixel
+	glm::vec3 baryDx, baryDy;
+	glm::vec3 pcPV;
+	// window space depth of the vertices, in [0, 1] and linear in screen space
+	glm::vec3 depth;
+	// depth steps per pixel. depthMargin bounds the rounding of the kernel's depth over a coarse block, the
+	// barycentrics grow with the gradients away from the vertices
+	float depthDx, depthDy;
+	float depthMargin;
+	// nearest depth the kernel computes for any pixel: the nearest vertex less the margin
+	float nearestDepth;
+	std::array<int, 4> bbox;
+
+	// nearest depth the kernel computes in the size x size pixels block with barycentrics bary at its first pixel
+	// center: the nearest corner of the depth plane, not nearer than the vertices
+	float nearestDepthIn(const glm::vec3& bary, const int size) const
+	{
+		const float corner = glm::dot(depth, bary) + std::min(0.0f, depthDx * (size - 1)) + std::min(0.0f, depthDy * (size - 1));
+		return std::max(nearestDepth, corner - depthMargin);
+	}
+};
+
+// hi-Z test: the triangle's nearest depth over some pixels behind the farthest depth stored there. the depth equal
+// pass still draws a pixel at exactly the stored depth
+template<DepthPass PASS>
+constexpr bool isBehindHiZ(const float nearest, const float farthest)
+{
+	return PASS == DepthPass::EQUAL ? nearest > farthest : nearest >= farthest;
+}
+
+template<typename Varyings>
+struct TriangleSetup : TriangleSetupBase
+{
+	// varyings of the vertices, interpolated perspective correct through pcPV
+	std::array<Varyings, 3> varyings;
+};
+
+// edge values of one block for the coverage test: floor(E / SUBPIXEL_ONE) at pixel centers. it has the
+// sign of E and steps by exactly A (B) per pixel, so it is stepped from block to block without division
+// and a block fits in 32 bit lanes once clamped: the sign of an edge that far away cannot change inside a block.
+// the barycentrics are kept separately in float, the floored values are too coarse for tiny triangles.
+struct BlockEdges
+{
+	static constexpr int64_t CLAMP = int64_t(1) << 30;
+
+	// exact edge values at the first pixel center, and the floored values
+	std::array<int64_t, 3> value;
+	std::array<int64_t, 3> start;
+	glm::vec3 bary;
+
+	BlockEdges(const TriangleSetupBase& setup, int blockX, int blockY)
+	{
+		const int64_t x = static_cast<int64_t>(blockX) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		const int64_t y = static_cast<int64_t>(blockY) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		for (int i = 0; i < 3; i++)
+		{
+			value[i] = setup.edges[i](x, y);
+			start[i] = floorDiv(value[i], SUBPIXEL_ONE);
+		}
+		updateBary(setup);
+	}
+
+	// the values of the block dx, dy pixels away
+	BlockEdges offset(const TriangleSetupBase& setup, int dx, int dy) const
+	{
+		BlockEdges moved = *this;
+		for (int i = 0; i < 3; i++)
+		{
+			const int64_t step = setup.edges[i].A * dx + setup.edges[i].B * dy;
+			moved.start[i] += step;
+			moved.value[i] += step * SUBPIXEL_ONE;
+		}
+		moved.updateBary(setup);
+		return moved;
+	}
+
+	// the next block of the row: exact for the coverage, the barycentrics step in float like inside the block
+	void stepX(const TriangleSetupBase& setup)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			start[i] += setup.edges[i].A * BLOCK_SIZE;
+			value[i] += setup.edges[i].A * (BLOCK_SIZE * SUBPIXEL_ONE);
+		}
+		bary += setup.baryDx * static_cast<float>(BLOCK_SIZE);
+	}
+
+	void updateBary(const TriangleSetupBase& setup)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			bary[i] = static_cast<float>(static_cast<double>(value[i]) * setup.invArea);
+		}
+	}
+
+	int32_t clamped(int i) const
+	{
+		return static_cast<int32_t>(std::max(-CLAMP, std::min(CLAMP, start[i])));
+	}
+
+	// coverage of the size x size pixels block: the extremes of each edge are at the corners picked by the signs of A and B
+	BlockCoverage classify(const TriangleSetupBase& setup, int size) const
+	{
+		bool inside = true;
+		for (int i = 0; i < 3; i++)
+		{
+			const int64_t A = setup.edges[i].A, B = setup.edges[i].B, extent = size - 1;
+			const int64_t maxE = start[i] + extent * (std::max<int64_t>(A, 0) + std::max<int64_t>(B, 0));
+			const int64_t minE = start[i] + extent * (std::min<int64_t>(A, 0) + std::min<int64_t>(B, 0));
+			if (maxE < 0)
+			{
+				return BlockCoverage::OUTSIDE;
+			}
+			inside = inside && minE >= 0;
+		}
+		return inside ? BlockCoverage::INSIDE : BlockCoverage::PARTIAL;
+	}
+};
+
+// the depth attachment of a frame buffer, its hi-Z blocks and its pending clear flags. hiZ is nullptr when the frame
+// buffer has it disabled
+struct ZBuffer
+{
+	float* depth;
+	FrameBuffer::HiZBlock* hiZ;
+	int hiZPitch;
+	int width, height;
+	uint64_t* clearFlags;
+	int clearPitch;
+	float clearDepth;
+	uint32_t clearColor;
+
+	explicit ZBuffer(FrameBuffer& frameBuffer)
+		: depth(frameBuffer.depthData()), hiZ(frameBuffer.hiZData()), hiZPitch(frameBuffer.getHiZPitch()),
+		  width(frameBuffer.getWidth()), height(frameBuffer.getHeight()), clearFlags(frameBuffer.clearFlags()),
+		  clearPitch(frameBuffer.getClearPitch()), clearDepth(frameBuffer.getClearDepth()), clearColor(frameBuffer.getClearColor()) {}
+
+	// the first touch of a block after a clear writes the clear values into its depths and colors. a bin owns the
+	// flag words of its tiles
+	template<typename Addressing>
+	void materialize(const int blockX, const int blockY, uint32_t* colorBuffer, const Addressing addressing) const
+	{
+		using namespace simd;
+		uint64_t& flags = clearFlags[(blockY / FrameBuffer::CLEAR_TILE_SIZE) * clearPitch + blockX / FrameBuffer::CLEAR_TILE_SIZE];
+		const uint64_t bit = FrameBuffer::clearBit(blockX, blockY);
+		if ((flags & bit) == 0)
+		{
+			return;
+		}
+		flags &= ~bit;
+		const VFloat depthValue = set1(clearDepth);
+		const VInt colorValue = set1(static_cast<int32_t>(clearColor));
+		const int rows = std::min(BLOCK_SIZE, height - blockY);
+		for (int row = 0; row < rows; row++)
+		{
+			for (int x = blockX; x < blockX + BLOCK_SIZE; x += WIDTH)
+			{
+				const size_t index = addressing(x, blockY + row);
+				store(depth + index, depthValue);
+				store(colorBuffer + index, colorValue);
+			}
+		}
+	}
+
+	// hi-Z of the block with its first pixel at (blockX, blockY)
+	FrameBuffer::HiZBlock& block(const int blockX, const int blockY) const
+	{
+		return hiZ[(blockY / BLOCK_SIZE) * hiZPitch + blockX / BLOCK_SIZE];
+	}
+
+	// farthest hi-Z of the blocks overlapping the pixels rect
+	float farthest(const std::array<int, 4>& rect) const
+	{
+		float result = block(rect[0], rect[1]).farthest;
+		for (int y = rect[1] / BLOCK_SIZE; y <= rect[3] / BLOCK_SIZE; y++)
+		{
+			const FrameBuffer::HiZBlock* row = hiZ + y * hiZPitch;
+			for (int x = rect[0] / BLOCK_SIZE; x <= rect[2] / BLOCK_SIZE; x++)
+			{
+				result = std::max(result, row[x].farthest);
+			}
+		}
+		return result;
+	}
+
+	// the hi-Z of the block from its depths, the pixels past the frame buffer edges left out
+	template<typename Addressing>
+	void rescan(const int blockX, const int blockY, const Addressing addressing) const
+	{
+		using namespace simd;
+		constexpr int CHUNKS = BLOCK_SIZE / WIDTH;
+		const VFloat outside = set1(-std::numeric_limits<float>::infinity());
+		const int rows = std::min(BLOCK_SIZE, height - blockY);
+		std::array<VFloat, BLOCK_SIZE * CHUNKS> pixels;
+		VFloat farthest = outside;
+		for (int chunk = 0; chunk < CHUNKS; chunk++)
+		{
+			const int x = blockX + chunk * WIDTH;
+			const VInt inside = set1(width - x) > laneIndex();
+			for (int row = 0; row < BLOCK_SIZE; row++)
+			{
+				VFloat& pixel = pixels[row * CHUNKS + chunk];
+				pixel = row < rows && x < width ? select(inside, load(depth + addressing(x, blockY + row)), outside) : outside;
+				farthest = max(farthest, pixel);
+			}
+		}
+		FrameBuffer::HiZBlock& result = block(blockX, blockY);
+		result.farthest = reduceMax(farthest);
+		farthest = set1(result.farthest);
+		VInt count = set1(0);
+		for (const VFloat pixel : pixels)
+		{
+			count = count - andNot(set1(-1), pixel < farthest);
+		}
+		result.count = reduceAdd(count);
+	}
+};
+
+// the pixels of the block inside bbox. INSIDE: the block is known to be covered, the per pixel edge test is skipped.
+// the varyings are interpolated per layout, the loops over them are unrolled for its size, then shaded by the
+// fragment stage of the shader, after the depth test or before it as Shader::DEPTH_TEST says. the depth and color
+// writes are the ones of its DepthPass
+template<BlockCoverage COVERAGE, typename Addressing, typename Shader>
+void rasterizeBlock(const TriangleSetup<typename Shader::Varyings>& setup, const BlockEdges& blockEdges, const int blockX, const int blockY,
+						   const std::array<int, 4>& bbox, const ZBuffer& zBuffer, uint32_t* colorBuffer, const Addressing addressing, const Shader& shader,
+						   RasterStats& stats)
+{
+	using namespace simd;
+
+	zBuffer.materialize(blockX, blockY, colorBuffer, addressing);
+
+	// lane i of a vector starting at x holds E(x + i)
+	const VInt lanes = laneIndex();
+	const VInt laneOffset0 = ramp(static_cast<int32_t>(setup.edges[0].A));
+	const VInt laneOffset1 = ramp(static_cast<int32_t>(setup.edges[1].A));
+	const VInt laneOffset2 = ramp(static_cast<int32_t>(setup.edges[2].A));
+
+	const VFloat pcPV0 = set1(setup.pcPV.x), pcPV1 = set1(setup.pcPV.y), pcPV2 = set1(setup.pcPV.z);
+	const VFloat depth0 = set1(setup.depth.x), depth1 = set1(setup.depth.y), depth2 = set1(setup.depth.z);
+	const VFloat depthMin = set1(std::min({ setup.depth.x, setup.depth.y, setup.depth.z }));
+	const VFloat depthMax = set1(std::max({ setup.depth.x, setup.depth.y, setup.depth.z }));
+	const VFloat one = set1(1.0f);
+
+	// the block columns inside the bbox, blocks overhang it at the triangle border. the barycentrics of a column are
+	// its row's plus its offset in the block times baryDx, whatever the vector width: the 4 and 8 wide kernels round
+	// them the same and render the same pixels
+	constexpr int CHUNKS = BLOCK_SIZE / WIDTH;
+	std::array<VInt, CHUNKS> columnMask;
+	std::array<VFloat, CHUNKS> columnB0, columnB1, columnB2;
+	int chunks = 0, columns = 0;
+	for (; chunks < CHUNKS && blockX + chunks * WIDTH <= bbox[2]; chunks++)
+	{
+		const VInt xs = set1(blockX + chunks * WIDTH) + lanes;
+		columnMask[chunks] = (xs > set1(bbox[0] - 1)) & (set1(bbox[2] + 1) > xs);
+		columns += popCount(moveMask(columnMask[chunks]));
+		const VFloat offset = toFloat(set1(chunks * WIDTH) + lanes);
+		columnB0[chunks] = offset * set1(setup.baryDx.x);
+		columnB1[chunks] = offset * set1(setup.baryDx.y);
+		columnB2[chunks] = offset * set1(setup.baryDx.z);
+	}
+
+	const int yBegin = std::max(blockY, bbox[1]), yEnd = std::min(blockY + BLOCK_SIZE - 1, bbox[3]);
+	const int32_t dy = yBegin - blockY;
+	const glm::vec3 rowBary = blockEdges.bary + setup.baryDy * static_cast<float>(dy);
+	VInt rowE0 = set1(blockEdges.clamped(0) + dy * static_cast<int32_t>(setup.edges[0].B)) + laneOffset0;
+	VInt rowE1 = set1(blockEdges.clamped(1) + dy * static_cast<int32_t>(setup.edges[1].B)) + laneOffset1;
+	VInt rowE2 = set1(blockEdges.clamped(2) + dy * static_cast<int32_t>(setup.edges[2].B)) + laneOffset2;
+	VFloat rowB0 = set1(rowBary.x), rowB1 = set1(rowBary.y), rowB2 = set1(rowBary.z);
+
+	const VInt stepYE0 = set1(static_cast<int32_t>(setup.edges[0].B));
+	const VInt stepYE1 = set1(static_cast<int32_t>(setup.edges[1].B));
+	const VInt stepYE2 = set1(static_cast<int32_t>(setup.edges[2].B));
+	const VInt stepXE0 = set1(static_cast<int32_t>(setup.edges[0].A * WIDTH));
+	const VInt stepXE1 = set1(static_cast<int32_t>(setup.edges[1].A * WIDTH));
+	const VInt stepXE2 = set1(static_cast<int32_t>(setup.edges[2].A * WIDTH));
+	const VFloat stepYB0 = set1(setup.baryDy.x), stepYB1 = set1(setup.baryDy.y), stepYB2 = set1(setup.baryDy.z);
+
+	using Layout = VaryingLayout<typename Shader::Varyings>;
+	const float* varyings0 = Layout::data(setup.varyings[0]);
+	const float* varyings1 = Layout::data(setup.varyings[1]);
+	const float* varyings2 = Layout::data(setup.varyings[2]);
+	// varyings of the lanes at barycentrics b0, b1, b2, perspective correct
+	const auto interpolateVaryings = [&](const VFloat b0, const VFloat b1, const VFloat b2, VFloat* varyings)
+	{
+		const VFloat invDot = one / (pcPV0 * b0 + pcPV1 * b1 + pcPV2 * b2);
+		const VFloat c0 = pcPV0 * b0 * invDot, c1 = pcPV1 * b1 * invDot, c2 = pcPV2 * b2 * invDot;
+		for (int i = 0; i < Layout::COUNT; i++)
+		{
+			varyings[i] = c0 * set1(varyings0[i]) + c1 * set1(varyings1[i]) + c2 * set1(varyings2[i]);
+		}
+	};
+
+	constexpr DepthPass PASS = ShaderDepthPass<Shader>::VALUE;
+	// covered / shaded lanes are -1, subtracting them counts the pixels without a popcount per vector
+	VInt coveredLanes = set1(0), shadedLanes = set1(0);
+	// the pixels at the farthest depth of the block that are overwritten
+	FrameBuffer::HiZBlock* hiZ = zBuffer.hiZ != nullptr ? &zBuffer.block(blockX, blockY) : nullptr;
+	const VFloat farthest = set1(hiZ != nullptr ? hiZ->farthest : 0.0f);
+	VInt farthestLanes = set1(0);
+	for (int y = yBegin; y <= yEnd; y++)
+	{
+		VInt e0 = rowE0, e1 = rowE1, e2 = rowE2;
+		for (int chunk = 0; chunk < chunks; chunk++)
+		{
+			const VFloat b0 = rowB0 + columnB0[chunk], b1 = rowB1 + columnB1[chunk], b2 = rowB2 + columnB2[chunk];
+			// inside when no edge value is negative
+			VInt covered = columnMask[chunk];
+			if constexpr (COVERAGE == BlockCoverage::PARTIAL)
+			{
+				covered = covered & nonNegative(e0 | e1 | e2);
+			}
+			const int coveredMask = moveMask(covered);
+			coveredLanes = coveredLanes - covered;
+			if (coveredMask != 0)
+			{
+				// window space depth is linear in screen space, no perspective correction. clamped to the depths of
+				// the vertices: the barycentrics stepped over a thin sliver drift far enough to pull it in front
+				const VFloat z = min(max(depth0 * b0 + depth1 * b1 + depth2 * b2, depthMin), depthMax);
+				const size_t index = addressing(blockX + chunk * WIDTH, y);
+				const VFloat zOld = load(zBuffer.depth + index);
+				VFloat varyings[Layout::COUNT > 0 ? Layout::COUNT : 1];
+
+				if constexpr (Shader::DEPTH_TEST == DepthTest::EARLY)
+				{
+					// early-Z: depth test, nearer wins (or the same depth for the EQUAL pass), then only the vectors
+					// with a pixel left are interpolated and shaded
+					const VInt pass = covered & (PASS == DepthPass::EQUAL ? z == zOld : z < zOld);
+					if (moveMask(pass) != 0)
+					{
+						if constexpr (PASS != DepthPass::EQUAL)
+						{
+							farthestLanes = farthestLanes - andNot(pass, zOld < farthest);
+							store(zBuffer.depth + index, select(pass, z, zOld));
+						}
+						if constexpr (PASS != DepthPass::DEPTH_ONLY)
+						{
+							shadedLanes = shadedLanes - pass;
+							interpolateVaryings(b0, b1, b2, varyings);
+							store(colorBuffer + index, select(pass, shader.fragment(varyings), load(colorBuffer + index)));
+						}
+					}
+				}
+				else
+				{
+					// late-Z: the fragment stage may discard pixels or move them in depth, every covered pixel is
+					// shaded and the depth test takes its output
+					VFloat depth = z;
+					VInt discard = set1(0);
+					shadedLanes = shadedLanes - covered;
+					interpolateVaryings(b0, b1, b2, varyings);
+					const VInt color = shader.fragment(varyings, depth, discard);
+					const VInt pass = andNot(covered, discard) & (PASS == DepthPass::EQUAL ? depth == zOld : depth < zOld);
+					if (moveMask(pass) != 0)
+					{
+						if constexpr (PASS != DepthPass::EQUAL)
+						{
+							farthestLanes = farthestLanes - andNot(pass, zOld < farthest);
+							store(zBuffer.depth + index, select(pass, depth, zOld));
+						}
+						if constexpr (PASS != DepthPass::DEPTH_ONLY)
+						{
+							store(colorBuffer + index, select(pass, color, load(colorBuffer + index)));
+						}
+					}
+				}
+			}
+			e0 = e0 + stepXE0; e1 = e1 + stepXE1; e2 = e2 + stepXE2;
+		}
+		rowE0 = rowE0 + stepYE0; rowE1 = rowE1 + stepYE1; rowE2 = rowE2 + stepYE2;
+		rowB0 = rowB0 + stepYB0; rowB1 = rowB1 + stepYB1; rowB2 = rowB2 + stepYB2;
+	}
+	if constexpr (COVERAGE == BlockCoverage::PARTIAL)
+	{
+		stats.pixelsTested += columns * (yEnd - yBegin + 1);
+	}
+	stats.pixelsCovered += reduceAdd(coveredLanes);
+	stats.pixelsShaded += reduceAdd(shadedLanes);
+	if (hiZ != nullptr)
+	{
+		// depths only get nearer: the farthest one is gone once none of its pixels is left
+		hiZ->count -= reduceAdd(farthestLanes);
+		if (hiZ->count <= 0)
+		{
+			zBuffer.rescan(blockX, blockY, addressing);
+		}
+	}
+}
+
+// the 8x8 blocks between xBegin..xEnd, yBegin..yEnd (block aligned), from the edge values at (originX, originY).
+// inside: the whole range is known to be covered
+template<typename Addressing, typename Shader>
+void rasterizeBlocks(const TriangleSetup<typename Shader::Varyings>& setup, const BlockEdges& originEdges, const int originX, const int originY,
+							const int xBegin, const int xEnd, const int yBegin, const int yEnd, const bool inside, const std::array<int, 4>& bbox,
+							const ZBuffer& zBuffer, uint32_t* colorBuffer, const Addressing addressing, const Shader& shader, RasterStats& stats)
+{
+	constexpr DepthPass PASS = ShaderDepthPass<Shader>::VALUE;
+	for (int blockY = yBegin; blockY <= yEnd; blockY += BLOCK_SIZE)
+	{
+		BlockEdges blockEdges = originEdges.offset(setup, xBegin - originX, blockY - originY);
+		for (int blockX = xBegin; blockX <= xEnd; blockX += BLOCK_SIZE, blockEdges.stepX(setup))
+		{
+			const BlockCoverage coverage = inside ? BlockCoverage::INSIDE : blockEdges.classify(setup, BLOCK_SIZE);
+			if (coverage == BlockCoverage::OUTSIDE)
+			{
+				stats.blocksRejected++;
+			}
+			else if (zBuffer.hiZ != nullptr && isBehindHiZ<PASS>(setup.nearestDepthIn(blockEdges.bary, BLOCK_SIZE), zBuffer.block(blockX, blockY).farthest))
+			{
+				// behind every depth of the block
+				stats.blocksOccluded++;
+			}
+			else if (coverage == BlockCoverage::INSIDE)
+			{
+				stats.blocksAccepted++;
+				rasterizeBlock<BlockCoverage::INSIDE>(setup, blockEdges, blockX, blockY, bbox, zBuffer, colorBuffer, addressing, shader, stats);
+			}
+			else
+			{
+				stats.blocksPartial++;
+				rasterizeBlock<BlockCoverage::PARTIAL>(setup, blockEdges, blockX, blockY, bbox, zBuffer, colorBuffer, addressing, shader, stats);
+			}
+		}
+	}
+}
+
+// snaps the triangle and sets up its edge functions, false when it covers no pixel center of the width x height target
+template<typename Varyings>
+bool setupTriangle(const TrianglePT<Varyings>& triangle, const int width, const int height, TriangleSetup<Varyings>& setup)
+{
+	std::array<glm::ivec2, 3> fixedPos = {};
+	std::array<glm::vec3, 3> triPos = {};
+	for (size_t i = 0; i < 3; i++) 
+	{
+		fixedPos[i] = snapToSubpixel(triangle.vertices[i].position);
+		triPos[i] = glm::vec3(glm::vec2(fixedPos[i]) / static_cast<float>(SUBPIXEL_ONE), triangle.vertices[i].position.z);
+	}
+
+	// edge i is opposite to vertex i, so E_i / area is the barycentric coordinate of vertex i
+	std::array<EdgeFunction, 3> edges = { EdgeFunction(fixedPos[1], fixedPos[2]), EdgeFunction(fixedPos[2], fixedPos[0]), EdgeFunction(fixedPos[0], fixedPos[1]) };
+	int64_t area = edges[0](fixedPos[0].x, fixedPos[0].y);
+	if (area == 0)
+	{
+		return false;
+	}
+	// both windings are drawn: turn clockwise triangles around so the fill rule sees one orientation
+	if (area < 0)
+	{
+		for (EdgeFunction& edge : edges)
+		{
+			edge.flip();
+		}
+		area = -area;
+	}
+	for (EdgeFunction& edge : edges)
+	{
+		edge.applyFillRule();
+	}
+	setup.edges = edges;
+	setup.invArea = 1.0 / static_cast<double>(area);
+	const float pixelInvArea = static_cast<float>(SUBPIXEL_ONE * setup.invArea);
+	setup.baryDx = glm::vec3(edges[0].A, edges[1].A, edges[2].A) * pixelInvArea;
+	setup.baryDy = glm::vec3(edges[0].B, edges[1].B, edges[2].B) * pixelInvArea;
+
+	// perspective correct parameter
+	setup.pcPV = {
+		triangle.vertices[1].position.w * triangle.vertices[2].position.w,
+		triangle.vertices[0].position.w * triangle.vertices[2].position.w,
+		triangle.vertices[0].position.w * triangle.vertices[1].position.w,
+	};
+	setup.depth = glm::vec3(triangle.vertices[0].position.z, triangle.vertices[1].position.z, triangle.vertices[2].position.z);
+	setup.depthDx = glm::dot(setup.depth, setup.baryDx);
+	setup.depthDy = glm::dot(setup.depth, setup.baryDy);
+	const glm::vec3 gradient = glm::abs(setup.baryDx) + glm::abs(setup.baryDy);
+	const glm::vec3 magnitude = glm::abs(setup.depth);
+	setup.depthMargin = DEPTH_ROUNDING * std::max({ magnitude.x, magnitude.y, magnitude.z }) *
+		(1.0f + COARSE_BLOCK_SIZE * (gradient.x + gradient.y + gradient.z));
+	setup.nearestDepth = std::min({ setup.depth.x, setup.depth.y, setup.depth.z }) - setup.depthMargin;
+	setup.varyings = { triangle.vertices[0].varyings, triangle.vertices[1].varyings, triangle.vertices[2].varyings };
+
+	setup.bbox = getBBox(triPos, width - 1, height - 1);
+	return setup.bbox[0] <= setup.bbox[2] && setup.bbox[1] <= setup.bbox[3];
+}
+
+// the pixels of the triangle inside bbox (part of setup.bbox)
+template<typename Addressing, typename Shader>
+void rasterizeTriangle(const TriangleSetup<typename Shader::Varyings>& setup, const std::array<int, 4>& bbox,
+							  const ZBuffer& zBuffer, uint32_t* colorBuffer, const Addressing addressing, const Shader& shader, RasterStats& stats)
+{
+	constexpr DepthPass PASS = ShaderDepthPass<Shader>::VALUE;
+	const int firstBlockX = bbox[0] & ~(BLOCK_SIZE - 1), firstBlockY = bbox[1] & ~(BLOCK_SIZE - 1);
+	if (bbox[2] - bbox[0] + 1 < COARSE_BLOCK_SIZE && bbox[3] - bbox[1] + 1 < COARSE_BLOCK_SIZE)
+	{
+		// a few hi-Z blocks: the whole triangle behind them is dropped before any edge setup
+		if (zBuffer.hiZ != nullptr && isBehindHiZ<PASS>(setup.nearestDepth, zBuffer.farthest(bbox)))
+		{
+			stats.trianglesOccluded++;
+			return;
+		}
+		// smaller than a coarse block: the coarse test could not accept anything, and not reject more than the 8x8 tests
+		const BlockEdges originEdges(setup, firstBlockX, firstBlockY);
+		rasterizeBlocks(setup, originEdges, firstBlockX, firstBlockY, firstBlockX, bbox[2], firstBlockY, bbox[3], false, bbox,
+			zBuffer, colorBuffer, addressing, shader, stats);
+		return;
+	}
+
+	// 64x64 blocks first, then the 8x8 blocks of the partially covered ones
+	for (int coarseY = bbox[1] & ~(COARSE_BLOCK_SIZE - 1); coarseY <= bbox[3]; coarseY += COARSE_BLOCK_SIZE)
+	{
+		for (int coarseX = bbox[0] & ~(COARSE_BLOCK_SIZE - 1); coarseX <= bbox[2]; coarseX += COARSE_BLOCK_SIZE)
+		{
+			const BlockEdges coarseEdges(setup, coarseX, coarseY);
+			const BlockCoverage coarseCoverage = coarseEdges.classify(setup, COARSE_BLOCK_SIZE);
+			if (coarseCoverage == BlockCoverage::OUTSIDE)
+			{
+				stats.coarseBlocksRejected++;
+				continue;
+			}
+			const std::array<int, 4> rect = {
+				std::max(coarseX, firstBlockX), std::max(coarseY, firstBlockY),
+				std::min(coarseX + COARSE_BLOCK_SIZE - 1, bbox[2]), std::min(coarseY + COARSE_BLOCK_SIZE - 1, bbox[3]),
+			};
+			if (zBuffer.hiZ != nullptr && isBehindHiZ<PASS>(setup.nearestDepthIn(coarseEdges.bary, COARSE_BLOCK_SIZE), zBuffer.farthest(rect)))
+			{
+				stats.coarseBlocksOccluded++;
+				continue;
+			}
+			stats.coarseBlocksAccepted += coarseCoverage == BlockCoverage::INSIDE;
+
+			rasterizeBlocks(setup, coarseEdges, coarseX, coarseY, rect[0], rect[2], rect[1], rect[3],
+				coarseCoverage == BlockCoverage::INSIDE, bbox, zBuffer, colorBuffer, addressing, shader, stats);
+		}
+	}
+}
+
+// the block kernel loads and stores whole 8 pixel rows of its block, bins made of whole blocks keep them apart
+static_assert(TileRasterizer::BIN_SIZE % BLOCK_SIZE == 0, "bins must be made of whole raster blocks");
+// and of whole clear tiles, the words of clear flags a bin updates are its own
+static_assert(TileRasterizer::BIN_SIZE % FrameBuffer::CLEAR_TILE_SIZE == 0, "bins must be made of whole clear tiles");
+
+// sets up triangles [begin, end) into setups[i] and appends the index of each one to the bins (row major, binsX
+// per row) its bbox overlaps
+template<typename Varyings>
+void binTriangles(const TrianglePT<Varyings>* triangles, const size_t begin, const size_t end, const int width, const int height,
+						 const int binsX, TriangleSetup<Varyings>* setups, std::vector<uint32_t>* bins, RasterStats& stats)
+{
+	constexpr int BIN_SIZE = TileRasterizer::BIN_SIZE;
+	for (size_t i = begin; i < end; i++)
+	{
+		TriangleSetup<Varyings>& setup = setups[i];
+		if (!setupTriangle(triangles[i], width, height, setup))
+		{
+			continue;
+		}
+		stats.triangles++;
+		for (int binY = setup.bbox[1] / BIN_SIZE; binY <= setup.bbox[3] / BIN_SIZE; binY++)
+		{
+			for (int binX = setup.bbox[0] / BIN_SIZE; binX <= setup.bbox[2] / BIN_SIZE; binX++)
+			{
+				bins[binY * binsX + binX].push_back(static_cast<uint32_t>(i));
+				stats.binnedTriangles++;
+			}
+		}
+	}
+}
+
+// rasterizes the bins of chunkCount chunks in parallel, jobs of up to binGrain bins. chunkSetups(chunk) is the setup array the
+// indices of chunk refer to, chunkBin(chunk, bin) the indices of chunk in bin. the chunks are walked in order so
+// every bin sees its triangles in submission order
+template<typename Shader, typename ChunkSetups, typename ChunkBin>
+void rasterizeBins(JobSystem& jobSystem, FrameBuffer& frameBuffer, const int chunkCount, const size_t binGrain,
+						  const ChunkSetups& chunkSetups, const ChunkBin& chunkBin, const Shader& shader, std::vector<RasterStats>& workerStats)
+{
+	constexpr int BIN_SIZE = TileRasterizer::BIN_SIZE;
+	const int width = frameBuffer.getWidth(), height = frameBuffer.getHeight();
+	const int binsX = (width + BIN_SIZE - 1) / BIN_SIZE, binsY = (height + BIN_SIZE - 1) / BIN_SIZE;
+	const ZBuffer zBuffer(frameBuffer);
+	uint32_t* colorBuffer = frameBuffer.colorData();
+
+	const auto rasterizeBin = [&](const int bin, const auto addressing, RasterStats& stats)
+	{
+		const int binX = bin % binsX, binY = bin / binsX;
+		const std::array<int, 4> binRect = {
+			binX * BIN_SIZE, binY * BIN_SIZE,
+			std::min(binX * BIN_SIZE + BIN_SIZE, width) - 1, std::min(binY * BIN_SIZE + BIN_SIZE, height) - 1,
+		};
+		for (int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const auto* setups = chunkSetups(chunk);
+			for (const uint32_t index : chunkBin(chunk, bin))
+			{
+				const auto& setup = setups[index];
+				const std::array<int, 4> bbox = {
+					std::max(setup.bbox[0], binRect[0]), std::max(setup.bbox[1], binRect[1]),
+					std::min(setup.bbox[2], binRect[2]), std::min(setup.bbox[3], binRect[3]),
+				};
+				rasterizeTriangle(setup, bbox, zBuffer, colorBuffer, addressing, shader, stats);
+			}
+		}
+	};
+
+	// idle workers steal the bins still queued
+	jobSystem.parallelFor(0, binsX * binsY, binGrain, [&](size_t first, size_t last, int worker)
+	{
+		// counted locally, neighbouring workers' stats share cache lines
+		RasterStats binStats;
+		for (size_t bin = first; bin < last; bin++)
+		{
+			if (frameBuffer.getLayout() == FrameBufferLayout::TILED)
+			{
+				rasterizeBin(static_cast<int>(bin), frameBuffer.tiledAddressing(), binStats);
+			}
+			else
+			{
+				rasterizeBin(static_cast<int>(bin), frameBuffer.linearAddressing(), binStats);
+			}
+		}
+		workerStats[worker] += binStats;
+	});
+}
+
+// ======== StreamRenderer ========
+
+// the buffers of one batch, reused by whichever batch of a window takes the slot
+template<typename Varyings>
+struct StreamRendererT<Varyings>::Batch
+{
+	// soup: the clip space triangles of the batch. mesh: its vertices, gathered and transformed once per batch
+	std::vector<TrianglePT<Varyings>> clipTriangles;
+	std::vector<uint32_t> clipOutcodes;
+	std::vector<float> x, y, z, clipX, clipY, clipZ, clipW;
+	std::vector<Varyings> varyings;
+	std::vector<uint32_t> localIndices;
+	// FIFO post-transform cache: global vertex index of every entry, and the batch vertex it was loaded into
+	std::vector<uint32_t> cacheTags, cacheVertices;
+
+	std::vector<TrianglePT<Varyings>> screenTriangles;
+	std::vector<TriangleSetup<Varyings>> setups;
+	std::vector<std::vector<uint32_t>> bins;
+	GeometryStats geometryStats;
+	RasterStats rasterStats;
+};
+
+template<typename Varyings>
+StreamRendererT<Varyings>::StreamRendererT(JobSystem& jobSystem) : jobSystem(jobSystem)
+{
+}
+
+template<typename Varyings>
+StreamRendererT<Varyings>::~StreamRendererT() = default;
+
+template<typename Varyings>
+template<typename Shader, typename ProcessBatch>
+void StreamRendererT<Varyings>::drawBatches(const size_t triangleCount, const Shader& shader, const ProcessBatch& processBatch, FrameBuffer& frameBuffer,
+											GeometryStats* geometryStats, RasterStats* rasterStats)
+{
+	static_assert(std::is_same<typename Shader::Varyings, Varyings>::value, "the shader's varyings are not the layout of this renderer");
+
+	const int frameWidth = frameBuffer.getWidth(), frameHeight = frameBuffer.getHeight();
+	const int binsX = (frameWidth + TileRasterizer::BIN_SIZE - 1) / TileRasterizer::BIN_SIZE;
+	const int binsY = (frameHeight + TileRasterizer::BIN_SIZE - 1) / TileRasterizer::BIN_SIZE;
+	const int threadCount = jobSystem.getThreadCount();
+	const size_t batchCount = (triangleCount + BATCH_TRIANGLES - 1) / BATCH_TRIANGLES;
+	const size_t windowBatches = static_cast<size_t>(WINDOW_BATCHES) * threadCount;
+	const size_t binGrain = std::max<size_t>(1, static_cast<size_t>(binsX) * binsY / (WINDOW_BATCHES * threadCount));
+	if (batches.size() < std::min(batchCount, windowBatches))
+	{
+		batches.resize(std::min(batchCount, windowBatches));
+	}
+	workerStats.assign(threadCount, RasterStats());
+	clippers.resize(threadCount);
+
+	for (size_t windowBegin = 0; windowBegin < batchCount; windowBegin += windowBatches)
+	{
+		const size_t windowEnd = std::min(batchCount, windowBegin + windowBatches);
+
+		// geometry, setup and binning of every batch of the window, each batch into its own slot
+		jobSystem.parallelFor(windowBegin, windowEnd, 1, [&](size_t first, size_t last, int worker)
+		{
+			BatchClipper<VertexPT<Varyings>>& clipper = clippers[worker];
+			for (size_t batchIndex = first; batchIndex < last; batchIndex++)
+			{
+				Batch& batch = batches[batchIndex - windowBegin];
+				const size_t begin = batchIndex * BATCH_TRIANGLES, end = std::min(triangleCount, begin + BATCH_TRIANGLES);
+				batch.screenTriangles.clear();
+				processBatch(batch, begin, end, clipper);
+				batch.geometryStats.triangles += end - begin;
+				batch.geometryStats.output += batch.screenTriangles.size();
+
+				batch.setups.resize(batch.screenTriangles.size());
+				batch.bins.resize(static_cast<size_t>(binsX) * binsY);
+				for (std::vector<uint32_t>& bin : batch.bins)
+				{
+					bin.clear();
+				}
+				binTriangles(batch.screenTriangles.data(), 0, batch.screenTriangles.size(), frameWidth, frameHeight, binsX,
+					batch.setups.data(), batch.bins.data(), batch.rasterStats);
+			}
+		});
+
+		// raster: the window's batches in order, as one chunk each. a window has few triangles per bin, a job per
+		// bin would cost more than the bin itself
+		rasterizeBins(jobSystem, frameBuffer, static_cast<int>(windowEnd - windowBegin), binGrain,
+			[&](int chunk) { return batches[chunk].setups.data(); },
+			[&](int chunk, int bin) -> const std::vector<uint32_t>& { return batches[chunk].bins[bin]; }, shader, workerStats);
+	}
+
+	// the stats of the batch slots were accumulated over every window
+	for (Batch& batch : batches)
+	{
+		if (geometryStats != nullptr)
+		{
+			*geometryStats += batch.geometryStats;
+		}
+		if (rasterStats != nullptr)
+		{
+			*rasterStats += batch.rasterStats;
+		}
+		batch.geometryStats = GeometryStats();
+		batch.rasterStats = RasterStats();
+	}
+	if (rasterStats != nullptr)
+	{
+		for (const RasterStats& workerStat : workerStats)
+		{
+			*rasterStats += workerStat;
+		}
+	}
+}
+
+template<typename Varyings>
+template<typename Shader>
+void StreamRendererT<Varyings>::draw(const std::vector<Triangle>& triangles, const Shader& shader,
+									 const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+									 const int width, const int height, FrameBuffer& frameBuffer,
+									 const GeometryOptions& options, GeometryStats* geometryStats, RasterStats* rasterStats)
+{
+	const glm::mat4 mvp = p * v * m;
+	const glm::vec2 guardBand = getGuardBand(width, height);
+	drawBatches(triangles.size(), shader, [&](Batch& batch, size_t begin, size_t end, BatchClipper<VertexPT<Varyings>>& clipper)
+	{
+		batch.clipTriangles.resize(end - begin);
+		batch.clipOutcodes.resize(3 * (end - begin));
+		transformTriangles(triangles, begin, end, mvp, guardBand, shader, batch.clipTriangles.data(), batch.clipOutcodes.data());
+
+		const auto fetchTriangle = [&](size_t i, uint32_t* outcodes) -> const TrianglePT<Varyings>&
+		{
+			std::copy_n(&batch.clipOutcodes[3 * i], 3, outcodes);
+			return batch.clipTriangles[i];
+		};
+		clipAndMapRange(fetchTriangle, 0, end - begin, width, height, options, clipper, batch.screenTriangles, batch.geometryStats);
+	}, frameBuffer, geometryStats, rasterStats);
+}
+
+template<typename Varyings>
+template<typename Shader>
+void StreamRendererT<Varyings>::draw(const Mesh& mesh, const Shader& shader,
+									 const glm::mat4& m, const glm::mat4& v, const glm::mat4& p,
+									 const int width, const int height, FrameBuffer& frameBuffer,
+									 const GeometryOptions& options, GeometryStats* geometryStats, RasterStats* rasterStats)
+{
+	const glm::mat4 mvp = p * v * m;
+	const glm::vec2 guardBand = getGuardBand(width, height);
+	drawBatches(mesh.getTriangleCount(), shader, [&](Batch& batch, size_t begin, size_t end, BatchClipper<VertexPT<Varyings>>& clipper)
+	{
+		// gather the vertices of the batch through a FIFO post-transform cache of VERTEX_CACHE_SIZE entries, the one
+		// optimizeVertexCache orders the indices for and computeACMR measures: a vertex is loaded again once
+		// VERTEX_CACHE_SIZE others were loaded after it. the vertex stage of the shader runs on each load
+		batch.cacheTags.assign(VERTEX_CACHE_SIZE, UINT32_MAX);
+		batch.cacheVertices.resize(VERTEX_CACHE_SIZE);
+		int cacheNext = 0;
+		batch.localIndices.resize(3 * (end - begin));
+		for (std::vector<float>* buffer : { &batch.x, &batch.y, &batch.z })
+		{
+			buffer->clear();
+		}
+		batch.varyings.clear();
+		for (size_t i = 3 * begin; i < 3 * end; i++)
+		{
+			const uint32_t index = mesh.indices[i];
+			// newest entries first, the ones a well ordered mesh hits
+			int slot = cacheNext;
+			for (int k = 0; k < VERTEX_CACHE_SIZE && slot == cacheNext; k++)
+			{
+				const int entry = (cacheNext + VERTEX_CACHE_SIZE - 1 - k) % VERTEX_CACHE_SIZE;
+				if (batch.cacheTags[entry] == index)
+				{
+					slot = entry;
+				}
+			}
+			if (batch.cacheTags[slot] != index)
+			{
+				// miss: the oldest entry is replaced
+				batch.cacheTags[slot] = index;
+				batch.cacheVertices[slot] = static_cast<uint32_t>(batch.x.size());
+				cacheNext = (cacheNext + 1) % VERTEX_CACHE_SIZE;
+				batch.x.push_back(mesh.positionX[index]);
+				batch.y.push_back(mesh.positionY[index]);
+				batch.z.push_back(mesh.positionZ[index]);
+				batch.varyings.push_back(shader.vertex(getAttributes(mesh, index)));
+			}
+			batch.localIndices[i - 3 * begin] = batch.cacheVertices[slot];
+		}
+
+		// process in vertex shader
+		const size_t vertexCount = batch.x.size();
+		for (std::vector<float>* buffer : { &batch.clipX, &batch.clipY, &batch.clipZ, &batch.clipW })
+		{
+			buffer->resize(vertexCount);
+		}
+		batch.clipOutcodes.resize(vertexCount);
+		transformPositions(mvp, batch.x.data(), batch.y.data(), batch.z.data(), vertexCount,
+			batch.clipX.data(), batch.clipY.data(), batch.clipZ.data(), batch.clipW.data(), batch.clipOutcodes.data(), guardBand);
+
+		// primitive assembly from the batch vertices
+		const auto fetchTriangle = [&](size_t i, uint32_t* outcodes)
+		{
+			TrianglePT<Varyings> triangle;
+			for (size_t j = 0; j < 3; j++)
+			{
+				const uint32_t local = batch.localIndices[3 * i + j];
+				triangle.vertices[j].position = glm::vec4(batch.clipX[local], batch.clipY[local], batch.clipZ[local], batch.clipW[local]);
+				triangle.vertices[j].varyings = batch.varyings[local];
+				outcodes[j] = batch.clipOutcodes[local];
+			}
+			return triangle;
+		};
+		clipAndMapRange(fetchTriangle, 0, end - begin, width, height, options, clipper, batch.screenTriangles, batch.geometryStats);
+	}, frameBuffer, geometryStats, rasterStats);
+}
+
+template<typename Varyings>
+size_t StreamRendererT<Varyings>::getBufferBytes() const
+{
+	size_t bytes = 0;
+	for (const Batch& batch : batches)
+	{
+		bytes += batch.clipTriangles.capacity() * sizeof(TrianglePT<Varyings>) + batch.screenTriangles.capacity() * sizeof(TrianglePT<Varyings>);
+		bytes += batch.setups.capacity() * sizeof(TriangleSetup<Varyings>) + batch.varyings.capacity() * sizeof(Varyings);
+		for (const std::vector<float>* buffer : { &batch.x, &batch.y, &batch.z, &batch.clipX, &batch.clipY, &batch.clipZ, &batch.clipW })
+		{
+			bytes += buffer->capacity() * sizeof(float);
+		}
+		for (const std::vector<uint32_t>* buffer : { &batch.clipOutcodes, &batch.localIndices, &batch.cacheTags, &batch.cacheVertices })
+		{
+			bytes += buffer->capacity() * sizeof(uint32_t);
+		}
+		for (const std::vector<uint32_t>& bin : batch.bins)
+		{
+			bytes += bin.capacity() * sizeof(uint32_t);
+		}
+	}
+	return bytes;
+}
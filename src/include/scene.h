@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "vertex.h"
+#include "mesh.h"
+#include "shader.h"
+
+// procedural test scenes in model space, viewed from (0, 0, 3) looking at the origin
+
+// the rgb triangle of the window app
+std::vector<Triangle> makeTriangleScene();
+
+// count random triangles with edges of about size units spread over the view, z in [-0.5, 0.5]
+std::vector<Triangle> makeSmallTrianglesScene(size_t count, float size, unsigned int seed = 1);
+
+// layers screen filling walls in z [-0.5, 0.5], about count triangles: layers - 1 hidden surfaces per pixel.
+// frontToBack: the nearest wall is submitted first, otherwise the farthest
+std::vector<Triangle> makeLayersScene(int layers, size_t count, bool frontToBack = true);
+
+// indexed uv sphere of radius around the origin, rings x segments quads of two triangles (one at the poles),
+// colored by the normal, with normals and uvs
+Mesh makeSphereMesh(int rings, int segments, float radius = 1.0f);
+
+// indexed axis aligned box from min to max of one color, 4 vertices per face with its normal and uvs over the face
+Mesh makeBoxMesh(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color);
+
+// a mesh of a multi mesh scene placed in the world: meshes[mesh] of its scene, its model space bounds, and whether it
+// hides others well enough to be drawn into an OcclusionCuller
+struct SceneObject
+{
+	uint32_t mesh;
+	glm::mat4 model;
+	Bounds bounds;
+	bool occluder;
+};
+
+// street level view of a city grid: rows x columns blocks of box buildings of random heights, the occluders, with
+// a sphere on the street left of each block, one behind it and one on their crossing. most spheres and the far
+// buildings are hidden. the objects list the buildings first, then the spheres
+struct CityScene
+{
+	std::vector<Mesh> meshes;
+	std::vector<SceneObject> objects;
+	// the camera of the scene, the others are viewed from (0, 0, 3)
+	glm::mat4 view;
+};
+
+CityScene makeCityScene(int rows, int columns, unsigned int seed = 7);
+
+// 2^sizeShift texels square checkerboard of checks x checks squares, the light squares transparent (alpha 0) with holes
+Texture makeCheckerTexture(int sizeShift, int checks, bool holes = false);
+
+// the triangles of an indexed mesh with their vertices duplicated, the input of the triangle soup pipeline
+std::vector<Triangle> expandMesh(const Mesh& mesh);
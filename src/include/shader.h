@@ -0,0 +1,227 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "simd.h"
+#include "framebuffer.h"
+
+// ======== Shaders ========
+
+// a shader is a plain struct handed to the pipeline as a template parameter, so both stages are inlined into the
+// geometry and raster loops of its own instantiation, without a virtual call per vertex or pixel:
+//
+//	using Varyings = ...;
+//		the attributes interpolated over a triangle, see VaryingLayout
+//	static constexpr DepthTest DEPTH_TEST = ...;
+//		where the depth test runs, see DepthTest
+//	Varyings vertex(const VertexAttributes& vertex) const;
+//		the varyings of a model space vertex. the clip space position is the model-view-projection transform of
+//		vertex.position, run by the SIMD transform kernel of the pipeline
+//	simd::VInt fragment(const simd::VFloat* varyings) const;
+//		EARLY: the RGBA8 colors of simd::WIDTH pixels from their perspective correct varyings, varyings[i] is
+//		float i of the layout
+//	simd::VInt fragment(const simd::VFloat* varyings, simd::VFloat& depth, simd::VInt& discard) const;
+//		LATE: the same, depth holds the interpolated window space depth of the lanes and may be moved farther (the
+//		hi-Z test skips the blocks behind the interpolated depth), the lanes set in discard (all bits) are not written
+//
+// StreamRendererT::draw of another shader is compiled where it is called, by including render_impl.h
+
+// EARLY: the depth test runs on the interpolated depth first, the varyings are only interpolated and shaded for the
+// pixels passing it. LATE: every covered pixel is shaded and tested after the fragment stage, the fallback for
+// shaders discarding pixels or writing depth
+enum class DepthTest { EARLY, LATE };
+
+// Z-prepass: the scene is drawn twice with the same geometry and rasterizer. DEPTH_ONLY writes the depth of the
+// nearest surface and no color, without interpolating or shading (late-Z shaders still run their fragment stage for
+// its discards and depth), then EQUAL shades the pixels whose depth is the stored one and writes no depth, so an
+// early-Z shader runs once per visible pixel whatever the overdraw. of coplanar surfaces EQUAL keeps the last drawn.
+// NORMAL: depth test and shading in one pass, the default of a shader
+enum class DepthPass { NORMAL, DEPTH_ONLY, EQUAL };
+
+// Shader::DEPTH_PASS, NORMAL for the shaders without one
+template<typename Shader, typename = void>
+struct ShaderDepthPass
+{
+	static constexpr DepthPass VALUE = DepthPass::NORMAL;
+};
+
+template<typename Shader>
+struct ShaderDepthPass<Shader, std::void_t<decltype(Shader::DEPTH_PASS)>>
+{
+	static constexpr DepthPass VALUE = Shader::DEPTH_PASS;
+};
+
+// attributes of a model space vertex, zero for the ones the source does not have
+struct VertexAttributes
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+// rgb lanes in [0, 1] to the RGBA8 pixels of the color buffer, clamped: packRGBA8 of every lane
+inline simd::VInt packColor(const simd::VFloat* rgb)
+{
+	using namespace simd;
+	const VFloat zero = set1(0.0f), one = set1(1.0f), scale = set1(255.0f);
+	VInt packed = set1(static_cast<int32_t>(0xff000000u));
+	for (int channel = 0; channel < 3; channel++)
+	{
+		packed = packed | (truncate(min(max(rgb[channel], zero), one) * scale) << (8 * channel));
+	}
+	return packed;
+}
+
+// RGBA8 texture, width and height powers of two. texel (x, y) is texels[y * width + x], y = 0 at v = 0
+struct Texture
+{
+	int widthShift = 0, heightShift = 0;
+	std::vector<uint32_t> texels;
+
+	int getWidth() const { return 1 << widthShift; }
+	int getHeight() const { return 1 << heightShift; }
+};
+
+// one color over the whole triangle, nothing to interpolate
+struct FlatShader
+{
+	struct Varyings {};
+	static constexpr DepthTest DEPTH_TEST = DepthTest::EARLY;
+
+	uint32_t color;
+
+	explicit FlatShader(const glm::vec3& color) : color(packRGBA8(color)) {}
+
+	Varyings vertex(const VertexAttributes&) const { return {}; }
+	simd::VInt fragment(const simd::VFloat*) const { return simd::set1(static_cast<int32_t>(color)); }
+};
+
+// the vertex colors interpolated, the fixed function pipeline
+struct GouraudShader
+{
+	using Varyings = ColorVaryings;
+	static constexpr DepthTest DEPTH_TEST = DepthTest::EARLY;
+
+	Varyings vertex(const VertexAttributes& vertex) const { return { vertex.color }; }
+	simd::VInt fragment(const simd::VFloat* varyings) const { return packColor(varyings); }
+};
+
+// nearest texel of the interpolated uv, repeated outside [0, 1)
+struct TexturedShader
+{
+	struct Varyings
+	{
+		glm::vec2 uv;
+	};
+	static constexpr DepthTest DEPTH_TEST = DepthTest::EARLY;
+
+	const Texture* texture;
+
+	explicit TexturedShader(const Texture& texture) : texture(&texture) {}
+
+	Varyings vertex(const VertexAttributes& vertex) const { return { vertex.uv }; }
+	simd::VInt fragment(const simd::VFloat* varyings) const
+	{
+		using namespace simd;
+		const int width = texture->getWidth(), height = texture->getHeight();
+		const VInt x = truncate(varyings[0] * set1(static_cast<float>(width))) & set1(width - 1);
+		const VInt y = truncate(varyings[1] * set1(static_cast<float>(height))) & set1(height - 1);
+		return gather(texture->texels.data(), (y << texture->widthShift) + x);
+	}
+};
+
+// TexturedShader with alpha test: the texels with alpha below 128 are discarded, so the depth test runs late
+struct CutoutShader
+{
+	using Varyings = TexturedShader::Varyings;
+	static constexpr DepthTest DEPTH_TEST = DepthTest::LATE;
+
+	TexturedShader textured;
+
+	explicit CutoutShader(const Texture& texture) : textured(texture) {}
+
+	Varyings vertex(const VertexAttributes& vertex) const { return textured.vertex(vertex); }
+	simd::VInt fragment(const simd::VFloat* varyings, simd::VFloat&, simd::VInt& discard) const
+	{
+		using namespace simd;
+		const VInt texel = textured.fragment(varyings);
+		// alpha below 128: the sign bit is clear
+		discard = nonNegative(texel);
+		return texel | set1(static_cast<int32_t>(0xff000000u));
+	}
+};
+
+// diffuse lighting of the vertex colors by a directional light, the normal interpolated and normalized per pixel
+struct LambertShader
+{
+	struct Varyings
+	{
+		glm::vec3 normal;
+		glm::vec3 color;
+	};
+	static constexpr DepthTest DEPTH_TEST = DepthTest::EARLY;
+
+	// model space normals to the space of lightDirection, the inverse transpose of the model matrix
+	glm::mat3 normalMatrix;
+	// unit vector towards the light
+	glm::vec3 lightDirection;
+	float ambient;
+
+	LambertShader(const glm::mat4& model, const glm::vec3& lightDirection, float ambient = 0.1f)
+		: normalMatrix(glm::transpose(glm::inverse(glm::mat3(model)))), lightDirection(glm::normalize(lightDirection)), ambient(ambient) {}
+
+	Varyings vertex(const VertexAttributes& vertex) const { return { normalMatrix * vertex.normal, vertex.color }; }
+	simd::VInt fragment(const simd::VFloat* varyings) const
+	{
+		using namespace simd;
+		const VFloat dot = varyings[0] * set1(lightDirection.x) + varyings[1] * set1(lightDirection.y) + varyings[2] * set1(lightDirection.z);
+		const VFloat length = sqrt(varyings[0] * varyings[0] + varyings[1] * varyings[1] + varyings[2] * varyings[2]);
+		// no light from behind, and no division by a zero normal
+		const VFloat diffuse = max(dot, set1(0.0f)) / max(length, set1(1e-6f));
+		const VFloat intensity = set1(ambient) + set1(1.0f - ambient) * diffuse;
+		const VFloat rgb[3] = { varyings[3] * intensity, varyings[4] * intensity, varyings[5] * intensity };
+		return packColor(rgb);
+	}
+};
+
+// one pass of a Z-prepass drawn with shader. DEPTH_ONLY skips the vertex stage of early-Z shaders, their varyings
+// are not interpolated
+template<typename Shader, DepthPass PASS>
+struct DepthPassShader
+{
+	using Varyings = typename Shader::Varyings;
+	static constexpr DepthTest DEPTH_TEST = Shader::DEPTH_TEST;
+	static constexpr DepthPass DEPTH_PASS = PASS;
+
+	Shader shader;
+
+	explicit DepthPassShader(const Shader& shader) : shader(shader) {}
+
+	Varyings vertex(const VertexAttributes& vertex) const
+	{
+		if constexpr (PASS == DepthPass::DEPTH_ONLY && DEPTH_TEST == DepthTest::EARLY)
+		{
+			return {};
+		}
+		else
+		{
+			return shader.vertex(vertex);
+		}
+	}
+	simd::VInt fragment(const simd::VFloat* varyings) const { return shader.fragment(varyings); }
+	simd::VInt fragment(const simd::VFloat* varyings, simd::VFloat& depth, simd::VInt& discard) const
+	{
+		return shader.fragment(varyings, depth, discard);
+	}
+};
+
+template<typename Shader>
+using DepthOnlyShader = DepthPassShader<Shader, DepthPass::DEPTH_ONLY>;
+template<typename Shader>
+using DepthEqualShader = DepthPassShader<Shader, DepthPass::EQUAL>;
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+
+// thin wrappers over the widest instruction set enabled at compile time:
+// AVX2 (8 lanes), SSE2 (4 lanes, baseline on x86-64) or plain C++ (4 lanes).
+// masks are VInt with all bits set in the selected lanes.
+// define SOFTRENDER_FORCE_SCALAR to build the plain C++ fallback on x86.
+
+#if !defined(SOFTRENDER_FORCE_SCALAR) && defined(__AVX2__)
+#define SOFTRENDER_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(SOFTRENDER_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOFTRENDER_SIMD_SSE2
+#include <emmintrin.h>
+#else
+#define SOFTRENDER_SIMD_SCALAR
+#include <cmath>
+#endif
+
+namespace simd
+{
+
+// number of set bits of a lane mask from moveMask (at most 8 bits), without relying on a popcnt instruction
+inline int popCount(int mask)
+{
+	mask = mask - ((mask >> 1) & 0x55);
+	mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+	return (mask + (mask >> 4)) & 0x0f;
+}
+
+#if defined(SOFTRENDER_SIMD_AVX2)
+
+constexpr int WIDTH = 8;
+
+struct VFloat { __m256 v; };
+struct VInt { __m256i v; };
+
+inline VFloat set1(float a) { return { _mm256_set1_ps(a) }; }
+inline VInt set1(int32_t a) { return { _mm256_set1_epi32(a) }; }
+inline VInt laneIndex() { return { _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) }; }
+// lane i holds i * step
+inline VInt ramp(int32_t step) { return { _mm256_setr_epi32(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step) }; }
+inline VFloat load(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline VInt load(const uint32_t* p) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) }; }
+inline void store(float* p, VFloat a) { _mm256_storeu_ps(p, a.v); }
+inline void store(uint32_t* p, VInt a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a.v); }
+// lane i loads p[index lane i]
+inline VInt gather(const uint32_t* p, VInt index) { return { _mm256_i32gather_epi32(reinterpret_cast<const int*>(p), index.v, 4) }; }
+
+inline VFloat operator+(VFloat a, VFloat b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline VFloat operator-(VFloat a, VFloat b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline VFloat operator*(VFloat a, VFloat b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline VFloat operator/(VFloat a, VFloat b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline VFloat min(VFloat a, VFloat b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline VFloat max(VFloat a, VFloat b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline VFloat sqrt(VFloat a) { return { _mm256_sqrt_ps(a.v) }; }
+inline VInt operator<(VFloat a, VFloat b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)) }; }
+inline VInt operator==(VFloat a, VFloat b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)) }; }
+
+inline VInt operator+(VInt a, VInt b) { return { _mm256_add_epi32(a.v, b.v) }; }
+inline VInt operator-(VInt a, VInt b) { return { _mm256_sub_epi32(a.v, b.v) }; }
+inline VInt operator&(VInt a, VInt b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline VInt operator|(VInt a, VInt b) { return { _mm256_or_si256(a.v, b.v) }; }
+inline VInt operator^(VInt a, VInt b) { return { _mm256_xor_si256(a.v, b.v) }; }
+inline VInt operator>(VInt a, VInt b) { return { _mm256_cmpgt_epi32(a.v, b.v) }; }
+inline VInt operator==(VInt a, VInt b) { return { _mm256_cmpeq_epi32(a.v, b.v) }; }
+// a & ~b
+inline VInt andNot(VInt a, VInt b) { return { _mm256_andnot_si256(b.v, a.v) }; }
+inline VInt operator<<(VInt a, int n) { return { _mm256_slli_epi32(a.v, n) }; }
+// all bits set where a >= 0
+inline VInt nonNegative(VInt a) { return { _mm256_cmpgt_epi32(a.v, _mm256_set1_epi32(-1)) }; }
+
+inline VFloat toFloat(VInt a) { return { _mm256_cvtepi32_ps(a.v) }; }
+inline VInt truncate(VFloat a) { return { _mm256_cvttps_epi32(a.v) }; }
+
+inline VFloat select(VInt mask, VFloat a, VFloat b) { return { _mm256_blendv_ps(b.v, a.v, _mm256_castsi256_ps(mask.v)) }; }
+inline VInt select(VInt mask, VInt a, VInt b) { return { _mm256_blendv_epi8(b.v, a.v, mask.v) }; }
+// bit i set when lane i of mask is selected
+inline int moveMask(VInt mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask.v)); }
+inline int32_t reduceAdd(VInt a)
+{
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(a.v), _mm256_extracti128_si256(a.v, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+inline float reduceMax(VFloat a)
+{
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(m);
+}
+
+#elif defined(SOFTRENDER_SIMD_SSE2)
+
+constexpr int WIDTH = 4;
+
+struct VFloat { __m128 v; };
+struct VInt { __m128i v; };
+
+inline VFloat set1(float a) { return { _mm_set1_ps(a) }; }
+inline VInt set1(int32_t a) { return { _mm_set1_epi32(a) }; }
+inline VInt laneIndex() { return { _mm_setr_epi32(0, 1, 2, 3) }; }
+inline VInt ramp(int32_t step) { return { _mm_setr_epi32(0, step, 2 * step, 3 * step) }; }
+inline VFloat load(const float* p) { return { _mm_loadu_ps(p) }; }
+inline VInt load(const uint32_t* p) { return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) }; }
+inline void store(float* p, VFloat a) { _mm_storeu_ps(p, a.v); }
+inline void store(uint32_t* p, VInt a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.v); }
+// no gather before AVX2
+inline VInt gather(const uint32_t* p, VInt index)
+{
+	alignas(16) int32_t lanes[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), index.v);
+	return { _mm_setr_epi32(static_cast<int32_t>(p[lanes[0]]), static_cast<int32_t>(p[lanes[1]]),
+							static_cast<int32_t>(p[lanes[2]]), static_cast<int32_t>(p[lanes[3]])) };
+}
+
+inline VFloat operator+(VFloat a, VFloat b) { return { _mm_add_ps(a.v, b.v) }; }
+inline VFloat operator-(VFloat a, VFloat b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline VFloat operator*(VFloat a, VFloat b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline VFloat operator/(VFloat a, VFloat b) { return { _mm_div_ps(a.v, b.v) }; }
+inline VFloat min(VFloat a, VFloat b) { return { _mm_min_ps(a.v, b.v) }; }
+inline VFloat max(VFloat a, VFloat b) { return { _mm_max_ps(a.v, b.v) }; }
+inline VFloat sqrt(VFloat a) { return { _mm_sqrt_ps(a.v) }; }
+inline VInt operator<(VFloat a, VFloat b) { return { _mm_castps_si128(_mm_cmplt_ps(a.v, b.v)) }; }
+inline VInt operator==(VFloat a, VFloat b) { return { _mm_castps_si128(_mm_cmpeq_ps(a.v, b.v)) }; }
+
+inline VInt operator+(VInt a, VInt b) { return { _mm_add_epi32(a.v, b.v) }; }
+inline VInt operator-(VInt a, VInt b) { return { _mm_sub_epi32(a.v, b.v) }; }
+inline VInt operator&(VInt a, VInt b) { return { _mm_and_si128(a.v, b.v) }; }
+inline VInt operator|(VInt a, VInt b) { return { _mm_or_si128(a.v, b.v) }; }
+inline VInt operator^(VInt a, VInt b) { return { _mm_xor_si128(a.v, b.v) }; }
+inline VInt operator>(VInt a, VInt b) { return { _mm_cmpgt_epi32(a.v, b.v) }; }
+inline VInt operator==(VInt a, VInt b) { return { _mm_cmpeq_epi32(a.v, b.v) }; }
+inline VInt andNot(VInt a, VInt b) { return { _mm_andnot_si128(b.v, a.v) }; }
+inline VInt operator<<(VInt a, int n) { return { _mm_slli_epi32(a.v, n) }; }
+inline VInt nonNegative(VInt a) { return { _mm_cmpgt_epi32(a.v, _mm_set1_epi32(-1)) }; }
+
+inline VFloat toFloat(VInt a) { return { _mm_cvtepi32_ps(a.v) }; }
+inline VInt truncate(VFloat a) { return { _mm_cvttps_epi32(a.v) }; }
+
+// SSE2 has no blendv
+inline VInt select(VInt mask, VInt a, VInt b) { return { _mm_or_si128(_mm_and_si128(mask.v, a.v), _mm_andnot_si128(mask.v, b.v)) }; }
+inline VFloat select(VInt mask, VFloat a, VFloat b)
+{
+	const __m128 m = _mm_castsi128_ps(mask.v);
+	return { _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)) };
+}
+inline int moveMask(VInt mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask.v)); }
+inline int32_t reduceAdd(VInt a)
+{
+	__m128i sum = _mm_add_epi32(a.v, _mm_shuffle_epi32(a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+inline float reduceMax(VFloat a)
+{
+	__m128 m = _mm_max_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(m);
+}
+
+#else
+
+constexpr int WIDTH = 4;
+
+struct VFloat { float v[WIDTH]; };
+struct VInt { int32_t v[WIDTH]; };
+
+template<typename R, typename A, typename Fn>
+inline R lanes(const A& a, Fn fn)
+{
+	R r;
+	for (int i = 0; i < WIDTH; i++) r.v[i] = fn(a.v[i]);
+	return r;
+}
+
+template<typename R, typename A, typename B, typename Fn>
+inline R lanes(const A& a, const B& b, Fn fn)
+{
+	R r;
+	for (int i = 0; i < WIDTH; i++) r.v[i] = fn(a.v[i], b.v[i]);
+	return r;
+}
+
+inline VFloat set1(float a) { VFloat r; for (float& v : r.v) v = a; return r; }
+inline VInt set1(int32_t a) { VInt r; for (int32_t& v : r.v) v = a; return r; }
+inline VInt laneIndex() { return { { 0, 1, 2, 3 } }; }
+inline VInt ramp(int32_t step) { VInt r; for (int i = 0; i < WIDTH; i++) r.v[i] = i * step; return r; }
+inline VFloat load(const float* p) { VFloat r; for (int i = 0; i < WIDTH; i++) r.v[i] = p[i]; return r; }
+inline VInt load(const uint32_t* p) { VInt r; for (int i = 0; i < WIDTH; i++) r.v[i] = static_cast<int32_t>(p[i]); return r; }
+inline void store(float* p, VFloat a) { for (int i = 0; i < WIDTH; i++) p[i] = a.v[i]; }
+inline void store(uint32_t* p, VInt a) { for (int i = 0; i < WIDTH; i++) p[i] = static_cast<uint32_t>(a.v[i]); }
+inline VInt gather(const uint32_t* p, VInt index) { VInt r; for (int i = 0; i < WIDTH; i++) r.v[i] = static_cast<int32_t>(p[index.v[i]]); return r; }
+
+inline VFloat operator+(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return x + y; }); }
+inline VFloat operator-(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return x - y; }); }
+inline VFloat operator*(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return x * y; }); }
+inline VFloat operator/(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return x / y; }); }
+inline VFloat min(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return y < x ? y : x; }); }
+inline VFloat max(VFloat a, VFloat b) { return lanes<VFloat>(a, b, [](float x, float y) { return x < y ? y : x; }); }
+inline VFloat sqrt(VFloat a) { return lanes<VFloat>(a, [](float x) { return std::sqrt(x); }); }
+inline VInt operator<(VFloat a, VFloat b) { return lanes<VInt>(a, b, [](float x, float y) { return x < y ? -1 : 0; }); }
+inline VInt operator==(VFloat a, VFloat b) { return lanes<VInt>(a, b, [](float x, float y) { return x == y ? -1 : 0; }); }
+
+inline VInt operator+(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return static_cast<int32_t>(static_cast<uint32_t>(x) + static_cast<uint32_t>(y)); }); }
+inline VInt operator-(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return static_cast<int32_t>(static_cast<uint32_t>(x) - static_cast<uint32_t>(y)); }); }
+inline VInt operator&(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x & y; }); }
+inline VInt operator|(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x | y; }); }
+inline VInt operator^(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x ^ y; }); }
+inline VInt operator>(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x > y ? -1 : 0; }); }
+inline VInt operator==(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x == y ? -1 : 0; }); }
+inline VInt andNot(VInt a, VInt b) { return lanes<VInt>(a, b, [](int32_t x, int32_t y) { return x & ~y; }); }
+inline VInt operator<<(VInt a, int n) { return lanes<VInt>(a, [n](int32_t x) { return static_cast<int32_t>(static_cast<uint32_t>(x) << n); }); }
+inline VInt nonNegative(VInt a) { return lanes<VInt>(a, [](int32_t x) { return x >= 0 ? -1 : 0; }); }
+
+inline VFloat toFloat(VInt a) { return lanes<VFloat>(a, [](int32_t x) { return static_cast<float>(x); }); }
+inline VInt truncate(VFloat a) { return lanes<VInt>(a, [](float x) { return static_cast<int32_t>(x); }); }
+
+inline VInt select(VInt mask, VInt a, VInt b) { VInt r; for (int i = 0; i < WIDTH; i++) r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; return r; }
+inline VFloat select(VInt mask, VFloat a, VFloat b) { VFloat r; for (int i = 0; i < WIDTH; i++) r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; return r; }
+inline int moveMask(VInt mask) { int r = 0; for (int i = 0; i < WIDTH; i++) r |= (mask.v[i] < 0 ? 1 : 0) << i; return r; }
+inline int32_t reduceAdd(VInt a) { int32_t r = 0; for (int i = 0; i < WIDTH; i++) r += a.v[i]; return r; }
+inline float reduceMax(VFloat a) { float r = a.v[0]; for (int i = 1; i < WIDTH; i++) r = r < a.v[i] ? a.v[i] : r; return r; }
+
+#endif
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// ======== vertex transform ========
+
+// vertices per batch of the structure of arrays transform, a multiple of 3 so a batch holds whole triangles
+static constexpr size_t TRANSFORM_BATCH = 768;
+
+// out = m * (x, y, z, 1) for count positions stored as separate x, y, z arrays, simd::WIDTH positions per step.
+// outcodes: when not null, the CLIP_* outcode of every output position (see clip.h), the guard band
+// bits for a guard band of guardBand * w. the outputs must not overlap the inputs
+void transformPositions(const glm::mat4& m, const float* x, const float* y, const float* z, size_t count,
+						float* outX, float* outY, float* outZ, float* outW, uint32_t* outcodes = nullptr,
+						const glm::vec2& guardBand = glm::vec2(1.0f));
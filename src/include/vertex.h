@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <type_traits>
 
 #include <glm/glm.hpp>
 
@@ -11,13 +12,41 @@ struct Vertex
 	glm::vec3 color;
 };
 
-// vertex : position with w
-struct VertexP
+// varyings: the attributes interpolated over a triangle. a plain struct of floats and float vectors (glm::vec2,
+// glm::vec3 ...), seen as COUNT consecutive floats by the clipper and the rasterizer, so their loops are generated
+// per layout and a layout only pays for its own attributes. an empty struct has no varyings
+template<typename Varyings>
+struct VaryingLayout
+{
+	static_assert(std::is_trivially_copyable<Varyings>::value && std::is_standard_layout<Varyings>::value,
+				  "varyings must be a plain struct of floats");
+	static_assert(std::is_empty<Varyings>::value || sizeof(Varyings) % sizeof(float) == 0, "varyings must be a plain struct of floats");
+
+	static constexpr int COUNT = std::is_empty<Varyings>::value ? 0 : static_cast<int>(sizeof(Varyings) / sizeof(float));
+
+	static float* data(Varyings& varyings) { return reinterpret_cast<float*>(&varyings); }
+	static const float* data(const Varyings& varyings) { return reinterpret_cast<const float*>(&varyings); }
+};
+
+// varyings of the fixed function pipeline
+struct ColorVaryings
 {
-	glm::vec4 position;
 	glm::vec3 color;
 };
 
+// vertex : position with w, and its varyings
+template<typename VaryingsT>
+struct VertexPT
+{
+	using Varyings = VaryingsT;
+	using Layout = VaryingLayout<VaryingsT>;
+
+	glm::vec4 position;
+	Varyings varyings;
+};
+
+using VertexP = VertexPT<ColorVaryings>;
+
 template<typename VertexT>
 struct TriangleT
 {
@@ -27,14 +56,30 @@ struct TriangleT
 // general triangle
 using Triangle = TriangleT<Vertex>;
 // triangle in render pipline
-using TriangleP = TriangleT<VertexP>;
+template<typename Varyings>
+using TrianglePT = TriangleT<VertexPT<Varyings>>;
+using TriangleP = TrianglePT<ColorVaryings>;
 
-template<typename VertexT>
-VertexT interpolate(const VertexT& A, const VertexT& B, float t)
+template<typename Varyings>
+Varyings interpolate(const Varyings& A, const Varyings& B, float t)
+{
+	using Layout = VaryingLayout<Varyings>;
+	Varyings result = A;
+	const float* a = Layout::data(A);
+	const float* b = Layout::data(B);
+	float* out = Layout::data(result);
+	for (int i = 0; i < Layout::COUNT; i++)
+	{
+		out[i] = a[i] + (b[i] - a[i]) * t;
+	}
+	return result;
+}
+
+template<typename Varyings>
+VertexPT<Varyings> interpolate(const VertexPT<Varyings>& A, const VertexPT<Varyings>& B, float t)
 {
 	auto pos = A.position + (B.position - A.position) * t;
-	auto color = A.color + (B.color - A.color) * t;
-	return { pos, color };
+	return { pos, interpolate(A.varyings, B.varyings, t) };
 }
 
 template<typename VertexT>
@@ -43,4 +88,4 @@ void assignData(VertexT* output, const VertexT* input, const size_t n)
 	for (size_t i = 0; i < n; i++) {
 		output[i] = input[i];
 	}
-}
\ No newline at end of file
+}
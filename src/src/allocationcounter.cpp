@@ -0,0 +1,37 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+#include "allocationcounter.h"
+
+using namespace std;
+
+static atomic<uint64_t> g_allocations{ 0 };
+
+uint64_t getAllocationCount()
+{
+	return g_allocations.load();
+}
+
+// the replaceable allocation functions the others forward to by default: new[] and the nothrow forms allocate through
+// operator new, delete[] and the sized forms free through operator delete
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, memory_order_relaxed);
+	if (void* p = malloc(size > 0 ? size : 1))
+	{
+		return p;
+	}
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,926 @@
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <random>
+#include <cstdlib>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "vertex.h"
+#include "render.h"
+#include "scene.h"
+#include "jobsystem.h"
+#include "transform.h"
+#include "alignedbuffer.h"
+#include "mesh.h"
+#include "clip.h"
+#include "shader.h"
+#include "occlusion.h"
+#include "allocationcounter.h"
+
+using namespace std;
+using namespace glm;
+
+// ======== bench ========
+
+using Clock = chrono::steady_clock;
+
+// average milliseconds of fn() over iterations runs, after one warm up run
+template<typename Fn>
+double timeMs(const int iterations, Fn fn)
+{
+	fn();
+	const auto start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		fn();
+	}
+	return chrono::duration<double, milli>(Clock::now() - start).count() / iterations;
+}
+
+void sceneCamera(const int width, const int height, mat4& view, mat4& projection)
+{
+	view = lookAt(vec3(0, 0, 3), vec3(0, 0, 0), vec3(0, 1, 0));
+	projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+}
+
+// linear vs tiled framebuffer on a scene of many small triangles
+void benchFrameBufferLayout()
+{
+	const int width = 1920, height = 1080, frames = 10;
+	const vector<Triangle> triangles = makeSmallTrianglesScene(200000, 0.02f);
+
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	vector<TriangleP> screenTriangles;
+	geometryProcess(screenTriangles, triangles, mat4(1.0f), view, projection, width - 1, height - 1);
+
+	struct Config
+	{
+		const char* name;
+		FrameBufferLayout layout;
+		int tileSize;
+	};
+	const Config configs[] = {
+		{ "linear",   FrameBufferLayout::LINEAR, 0 },
+		{ "tiled 8",  FrameBufferLayout::TILED,  8 },
+		{ "tiled 16", FrameBufferLayout::TILED,  16 },
+		{ "tiled 32", FrameBufferLayout::TILED,  32 },
+	};
+
+	printf("%zu triangles at %dx%d, %d frames\n", triangles.size(), width, height, frames);
+	printf("%-10s %10s %10s %10s\n", "layout", "clear ms", "raster ms", "resolve ms");
+	vector<uint8_t> image(4 * width * height);
+	for (const Config& config : configs)
+	{
+		FrameBuffer frameBuffer(width, height, config.layout, config.tileSize);
+		const double clearMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+		const double rasterMs = timeMs(frames, [&]
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			rasterize(screenTriangles, frameBuffer);
+		}) - clearMs;
+		const double resolveMs = timeMs(frames, [&] { frameBuffer.resolveRGBA8(&image[0]); });
+		printf("%-10s %10.3f %10.3f %10.3f\n", config.name, clearMs, rasterMs, resolveMs);
+	}
+}
+
+// serial rasterize vs the binned rasterizer on 1, 2, 4, ... threads
+void benchRasterThreads()
+{
+	const int width = 1920, height = 1080, frames = 10;
+	struct Scene
+	{
+		const char* name;
+		vector<Triangle> triangles;
+	};
+	const Scene scenes[] = {
+		{ "200k small", makeSmallTrianglesScene(200000, 0.02f) },
+		{ "20k medium", makeSmallTrianglesScene(20000, 0.2f) },
+	};
+
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	vector<int> threadCounts;
+	const int hardwareThreads = std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	for (int threads = 1; threads < hardwareThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	FrameBuffer frameBuffer(width, height);
+	printf("%dx%d, %d frames, %d hardware threads\n", width, height, frames, hardwareThreads);
+	printf("%-12s %-10s %10s %8s\n", "scene", "raster", "ms", "speedup");
+	for (const Scene& scene : scenes)
+	{
+		vector<TriangleP> screenTriangles;
+		geometryProcess(screenTriangles, scene.triangles, mat4(1.0f), view, projection, width - 1, height - 1);
+		const double clearMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+		const double serialMs = timeMs(frames, [&]
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			rasterize(screenTriangles, frameBuffer);
+		}) - clearMs;
+		printf("%-12s %-10s %10.3f %8.2f\n", scene.name, "serial", serialMs, 1.0);
+		for (const int threads : threadCounts)
+		{
+			JobSystem jobSystem(threads);
+			TileRasterizer rasterizer(jobSystem);
+			const double binnedMs = timeMs(frames, [&]
+			{
+				frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+				rasterizer.rasterize(screenTriangles, frameBuffer);
+			}) - clearMs;
+			char name[32];
+			snprintf(name, sizeof(name), "binned %d", threads);
+			printf("%-12s %-10s %10.3f %8.2f\n", scene.name, name, binnedMs, serialMs / binnedMs);
+		}
+	}
+}
+
+// vertex transform of a 1M vertex mesh: the old per vertex p * v * m * pos, the mvp concatenated once,
+// and the SoA kernel (straight from SoA arrays, and batched from AoS vertices as geometryProcess does)
+void benchVertexTransform()
+{
+	const size_t count = 1 << 20;
+	const int iterations = 20;
+	vector<Vertex> vertices(count);
+	mt19937 rng(1);
+	uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+	for (Vertex& vertex : vertices)
+	{
+		vertex.position = vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+	}
+	AlignedBuffer<float> x, y, z, outX, outY, outZ, outW;
+	for (AlignedBuffer<float>* buffer : { &x, &y, &z, &outX, &outY, &outZ, &outW })
+	{
+		buffer->resize(count);
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = vertices[i].position.x;
+		y[i] = vertices[i].position.y;
+		z[i] = vertices[i].position.z;
+	}
+	vector<vec4> out(count);
+
+	const mat4 model(1.0f);
+	mat4 view, projection;
+	sceneCamera(1920, 1080, view, projection);
+
+	const double perVertexMs = timeMs(iterations, [&]
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = projection * view * model * vec4(vertices[i].position, 1.0f);
+		}
+	});
+	const double mvpMs = timeMs(iterations, [&]
+	{
+		const mat4 mvp = projection * view * model;
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = mvp * vec4(vertices[i].position, 1.0f);
+		}
+	});
+	const double soaMs = timeMs(iterations, [&]
+	{
+		transformPositions(projection * view * model, x.data(), y.data(), z.data(), count, outX.data(), outY.data(), outZ.data(), outW.data());
+	});
+	const double batchedMs = timeMs(iterations, [&]
+	{
+		const mat4 mvp = projection * view * model;
+		alignas(64) float bx[TRANSFORM_BATCH], by[TRANSFORM_BATCH], bz[TRANSFORM_BATCH];
+		alignas(64) float cx[TRANSFORM_BATCH], cy[TRANSFORM_BATCH], cz[TRANSFORM_BATCH], cw[TRANSFORM_BATCH];
+		for (size_t begin = 0; begin < count; begin += TRANSFORM_BATCH)
+		{
+			const size_t batch = std::min(TRANSFORM_BATCH, count - begin);
+			for (size_t i = 0; i < batch; i++)
+			{
+				bx[i] = vertices[begin + i].position.x;
+				by[i] = vertices[begin + i].position.y;
+				bz[i] = vertices[begin + i].position.z;
+			}
+			transformPositions(mvp, bx, by, bz, batch, cx, cy, cz, cw);
+			for (size_t i = 0; i < batch; i++)
+			{
+				out[begin + i] = vec4(cx[i], cy[i], cz[i], cw[i]);
+			}
+		}
+	});
+
+	// the variants have to agree
+	double maxError = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const vec4 reference = projection * view * model * vec4(vertices[i].position, 1.0f);
+		maxError = std::max<double>(maxError, std::abs(reference.w - outW[i]) + std::abs(reference.x - outX[i]));
+	}
+
+	printf("%zu vertices, %d iterations, max difference %g\n", count, iterations, maxError);
+	printf("%-24s %10s %12s\n", "transform", "ms", "Mvertices/s");
+	const auto row = [&](const char* name, double ms) { printf("%-24s %10.3f %12.1f\n", name, ms, count / ms / 1000.0); };
+	row("p * v * m per vertex", perVertexMs);
+	row("mvp once", mvpMs);
+	row("SoA kernel", soaMs);
+	row("SoA batched from AoS", batchedMs);
+}
+
+// indexed sphere of ~500k triangles vs the same triangles as a soup: vertices transformed per triangle (ACMR)
+// of the generated, shuffled and reordered index buffer, and the geometry time of each
+void benchMesh()
+{
+	const int width = 1920, height = 1080, iterations = 10;
+	Mesh mesh = makeSphereMesh(360, 720);
+	const size_t vertexCount = mesh.getVertexCount(), triangleCount = mesh.getTriangleCount();
+	const vector<Triangle> soup = expandMesh(mesh);
+
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	vector<TriangleP> soupTriangles, meshTriangles;
+	const double soupMs = timeMs(iterations, [&]
+	{
+		geometryProcess(soupTriangles, soup, mat4(1.0f), view, projection, width - 1, height - 1);
+	});
+
+	printf("%zu vertices, %zu triangles, %d iterations\n", vertexCount, triangleCount, iterations);
+	printf("%-24s %10s %10s %12s\n", "index order", "ACMR 16", "ACMR 32", "geometry ms");
+	printf("%-24s %10.3f %10.3f %12.3f\n", "triangle soup", 3.0, 3.0, soupMs);
+	const auto row = [&](const char* name)
+	{
+		const double ms = timeMs(iterations, [&]
+		{
+			geometryProcess(meshTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1);
+		});
+		printf("%-24s %10.3f %10.3f %12.3f\n", name, computeACMR(mesh.indices, vertexCount, 16),
+			computeACMR(mesh.indices, vertexCount, 32), ms);
+	};
+	row("generated (row order)");
+
+	// the two pipelines have to produce the same triangles
+	bool identical = soupTriangles.size() == meshTriangles.size();
+	for (size_t i = 0; identical && i < soupTriangles.size(); i++)
+	{
+		for (size_t j = 0; j < 3; j++)
+		{
+			identical = identical && soupTriangles[i].vertices[j].position == meshTriangles[i].vertices[j].position;
+		}
+	}
+
+	// whole triangles in random order, the worst case for the cache
+	vector<uint32_t> order(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		order[i] = static_cast<uint32_t>(i);
+	}
+	shuffle(order.begin(), order.end(), mt19937(1));
+	vector<uint32_t> shuffled(mesh.indices.size());
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		copy_n(&mesh.indices[3 * order[i]], 3, &shuffled[3 * i]);
+	}
+	mesh.indices = shuffled;
+	row("shuffled");
+
+	const auto start = Clock::now();
+	optimizeVertexCache(mesh.indices, vertexCount);
+	const double reorderMs = chrono::duration<double, milli>(Clock::now() - start).count();
+	row("shuffled + reordered");
+	printf("reorder %.1f ms, mesh and soup output %s\n", reorderMs, identical ? "identical" : "DIFFERENT");
+}
+
+// polygon clipping at the x / y planes vs the guard band, on scenes reaching out of the screen: big triangles
+// spread over the view, and a sphere right in front of the camera
+void benchGuardBand()
+{
+	const int width = 1920, height = 1080, iterations = 10;
+	struct Scene
+	{
+		const char* name;
+		vector<Triangle> triangles;
+		vec3 eye;
+	};
+	const Scene scenes[] = {
+		{ "20k large", makeSmallTrianglesScene(20000, 0.5f), vec3(0, 0, 3) },
+		{ "close sphere", expandMesh(makeSphereMesh(180, 360)), vec3(0, 0, 1.3f) },
+	};
+
+	FrameBuffer frameBuffer(width, height);
+	printf("%dx%d, %d iterations\n", width, height, iterations);
+	printf("%-14s %-6s %10s %10s %10s %12s %10s %12s\n", "scene", "guard", "triangles", "clipped", "output", "geometry ms", "raster ms", "covered");
+	for (const Scene& scene : scenes)
+	{
+		const mat4 view = lookAt(scene.eye, vec3(0, 0, 0), vec3(0, 1, 0));
+		const mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+		for (const bool guardBand : { false, true })
+		{
+			GeometryOptions options;
+			options.guardBand = guardBand;
+			vector<TriangleP> screenTriangles;
+			GeometryStats geometryStats;
+			geometryProcess(screenTriangles, scene.triangles, mat4(1.0f), view, projection, width - 1, height - 1, nullptr, options, &geometryStats);
+			const double geometryMs = timeMs(iterations, [&]
+			{
+				geometryProcess(screenTriangles, scene.triangles, mat4(1.0f), view, projection, width - 1, height - 1, nullptr, options);
+			});
+			RasterStats rasterStats;
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			rasterize(screenTriangles, frameBuffer, &rasterStats);
+			const double clearMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+			const double rasterMs = timeMs(iterations, [&]
+			{
+				frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+				rasterize(screenTriangles, frameBuffer);
+			}) - clearMs;
+			printf("%-14s %-6s %10llu %10llu %10llu %12.3f %10.3f %12llu\n", scene.name, guardBand ? "on" : "off",
+				static_cast<unsigned long long>(geometryStats.triangles), static_cast<unsigned long long>(geometryStats.clipped),
+				static_cast<unsigned long long>(geometryStats.output), geometryMs, rasterMs,
+				static_cast<unsigned long long>(rasterStats.pixelsCovered));
+		}
+	}
+}
+
+// back face culling on a closed mesh: geometry and raster time, and the triangles left, for each cull mode
+void benchCulling()
+{
+	const int width = 1920, height = 1080, iterations = 10;
+	const Mesh mesh = makeSphereMesh(360, 720);
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+
+	struct Mode
+	{
+		const char* name;
+		CullMode cullMode;
+	};
+	const Mode modes[] = { { "none", CullMode::NONE }, { "back", CullMode::BACK }, { "front", CullMode::FRONT } };
+
+	FrameBuffer frameBuffer(width, height);
+	printf("sphere of %zu triangles at %dx%d, %d iterations\n", mesh.getTriangleCount(), width, height, iterations);
+	printf("%-8s %10s %10s %10s %12s %10s\n", "cull", "culled", "degenerate", "output", "geometry ms", "raster ms");
+	for (const Mode& mode : modes)
+	{
+		GeometryOptions options;
+		options.cullMode = mode.cullMode;
+		vector<TriangleP> screenTriangles;
+		GeometryStats geometryStats;
+		geometryProcess(screenTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1, nullptr, options, &geometryStats);
+		const double geometryMs = timeMs(iterations, [&]
+		{
+			geometryProcess(screenTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1, nullptr, options);
+		});
+		const double clearMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+		const double rasterMs = timeMs(iterations, [&]
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			rasterize(screenTriangles, frameBuffer);
+		}) - clearMs;
+		printf("%-8s %10llu %10llu %10llu %12.3f %10.3f\n", mode.name, static_cast<unsigned long long>(geometryStats.culled),
+			static_cast<unsigned long long>(geometryStats.degenerate), static_cast<unsigned long long>(geometryStats.output), geometryMs, rasterMs);
+	}
+}
+
+// per triangle Clipper vs classifyTriangles + BatchClipper on clip space triangles around the camera, many of them
+// crossing the near plane
+void benchClipping()
+{
+	const int width = 1920, height = 1080, iterations = 10;
+	const size_t count = 200000;
+	const mat4 view = lookAt(vec3(0, 0, 0), vec3(0, 0, -1), vec3(0, 1, 0));
+	const mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+	const mat4 mvp = projection * view;
+	const vec2 guardBand = vec2(2.0f * MAX_SCREEN_COORDINATE / width - 1.0f, 2.0f * MAX_SCREEN_COORDINATE / height - 1.0f);
+
+	mt19937 rng(7);
+	uniform_real_distribution<float> centerXY(-0.3f, 0.3f), centerZ(-0.4f, 0.0f), offset(-0.15f, 0.15f), unit(0.0f, 1.0f);
+	vector<Triangle> triangles(count);
+	vector<TriangleP> clipTriangles(count);
+	vector<uint32_t> outcodes(3 * count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const vec3 center(centerXY(rng), centerXY(rng), centerZ(rng));
+		for (int j = 0; j < 3; j++)
+		{
+			Vertex& vertex = triangles[i].vertices[j];
+			vertex.position = center + vec3(offset(rng), offset(rng), offset(rng));
+			vertex.color = vec3(unit(rng), unit(rng), unit(rng));
+			clipTriangles[i].vertices[j] = { mvp * vec4(vertex.position, 1.0f), { vertex.color } };
+			outcodes[3 * i + j] = Clipper<VertexP>::computeOutcode(clipTriangles[i].vertices[j], guardBand);
+		}
+	}
+
+	size_t scalarVertices = 0, batchVertices = 0, clipped = 0;
+	array<VertexP, Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT> polygon;
+	Clipper<VertexP> clipper;
+	const double scalarMs = timeMs(iterations, [&]
+	{
+		scalarVertices = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			scalarVertices += clipper.clipTriangle(&clipTriangles[i].vertices[0], &outcodes[3 * i], &polygon[0], true);
+		}
+	});
+
+	const size_t BATCH = 256;
+	BatchClipper<VertexP> batchClipper;
+	vector<uint32_t> split(3 * BATCH), planes(BATCH);
+	const double batchMs = timeMs(iterations, [&]
+	{
+		batchVertices = 0;
+		clipped = 0;
+		for (size_t begin = 0; begin < count; begin += BATCH)
+		{
+			const size_t n = std::min(BATCH, count - begin);
+			for (size_t i = 0; i < n; i++)
+			{
+				for (size_t j = 0; j < 3; j++)
+				{
+					split[j * BATCH + i] = outcodes[3 * (begin + i) + j];
+				}
+			}
+			classifyTriangles(&split[0], &split[BATCH], &split[2 * BATCH], n, true, planes.data());
+			batchClipper.clear();
+			for (size_t i = 0; i < n; i++)
+			{
+				if (planes[i] == 0)
+				{
+					batchVertices += 3;
+				}
+				else if (planes[i] != CLIP_REJECT)
+				{
+					batchClipper.add(clipTriangles[begin + i], planes[i]);
+				}
+			}
+			batchClipper.clip(guardBand);
+			clipped += batchClipper.getPolygonCount();
+			for (size_t i = 0; i < batchClipper.getPolygonCount(); i++)
+			{
+				batchVertices += batchClipper.getPolygon(i, &polygon[0]);
+			}
+		}
+	});
+
+	vector<TriangleP> screenTriangles;
+	GeometryProcessor geometryProcessor;
+	const double geometryMs = timeMs(iterations, [&]
+	{
+		geometryProcessor.process(screenTriangles, triangles, mat4(1.0f), view, projection, width - 1, height - 1);
+	});
+
+	printf("%zu triangles around the camera, %zu clipped (guard band on), %d iterations\n", count, clipped, iterations);
+	printf("%-30s %10s %12s\n", "clipper", "ms", "vertices");
+	printf("%-30s %10.3f %12zu\n", "Clipper per triangle", scalarMs, scalarVertices);
+	printf("%-30s %10.3f %12zu\n", "BatchClipper", batchMs, batchVertices);
+	printf("%-30s %10.3f\n", "GeometryProcessor (all stages)", geometryMs);
+}
+
+// heap allocations per frame once the buffers have grown: a GeometryProcessor and TileRasterizer kept from frame
+// to frame vs the one shot geometryProcess
+void benchAllocations()
+{
+	const int width = 1920, height = 1080, frames = 20;
+	const vector<Triangle> triangles = makeSmallTrianglesScene(200000, 0.02f);
+	const Mesh mesh = makeSphereMesh(180, 360);
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+
+	JobSystem jobSystem;
+	GeometryProcessor geometryProcessor(&jobSystem);
+	TileRasterizer rasterizer(jobSystem);
+	FrameBuffer frameBuffer(width, height);
+	vector<TriangleP> screenTriangles;
+
+	printf("%d frames at %dx%d, %d threads\n", frames, width, height, jobSystem.getThreadCount());
+	printf("%-28s %14s %10s\n", "stage", "allocs/frame", "ms");
+	const auto row = [&](const char* name, const auto& frame)
+	{
+		// warm up: the buffers grow to the scene
+		frame();
+		frame();
+		const uint64_t before = getAllocationCount();
+		const double ms = timeMs(frames, frame);
+		const uint64_t allocations = getAllocationCount() - before;
+		// timeMs runs one more warm up frame
+		printf("%-28s %14.1f %10.3f\n", name, static_cast<double>(allocations) / (frames + 1), ms);
+	};
+	row("soup geometryProcess", [&] { geometryProcess(screenTriangles, triangles, mat4(1.0f), view, projection, width - 1, height - 1, &jobSystem); });
+	row("soup GeometryProcessor", [&] { geometryProcessor.process(screenTriangles, triangles, mat4(1.0f), view, projection, width - 1, height - 1); });
+	row("mesh geometryProcess", [&] { geometryProcess(screenTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1, &jobSystem); });
+	row("mesh GeometryProcessor", [&] { geometryProcessor.process(screenTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1); });
+	row("TileRasterizer", [&] { rasterizer.rasterize(screenTriangles, frameBuffer); });
+}
+
+// whole-scene intermediate arrays (GeometryProcessor + TileRasterizer) vs StreamRenderer batches: frame time and the
+// bytes the intermediate buffers hold, for growing scenes
+void benchStreaming()
+{
+	const int width = 1920, height = 1080, iterations = 5;
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+
+	JobSystem jobSystem;
+	FrameBuffer frameBuffer(width, height);
+	printf("%dx%d, %d threads, %d iterations\n", width, height, jobSystem.getThreadCount(), iterations);
+	printf("%-8s %10s %14s %14s %14s %14s\n", "scene", "triangles", "arrays ms", "arrays KB", "stream ms", "stream KB");
+	const auto row = [&](const char* name, size_t triangleCount, const auto& drawArrays, const auto& drawStream,
+		const GeometryProcessor& geometryProcessor, const vector<TriangleP>& screenTriangles, const TileRasterizer& rasterizer,
+		const StreamRenderer& streamRenderer)
+	{
+		const double clearMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+		const double arraysMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); drawArrays(); }) - clearMs;
+		const double streamMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); drawStream(); }) - clearMs;
+		const size_t arraysBytes = geometryProcessor.getBufferBytes() + screenTriangles.capacity() * sizeof(TriangleP) + rasterizer.getBufferBytes();
+		printf("%-8s %10zu %14.3f %14.1f %14.3f %14.1f\n", name, triangleCount, arraysMs, arraysBytes / 1024.0,
+			streamMs, streamRenderer.getBufferBytes() / 1024.0);
+	};
+	for (const int count : { 50000, 200000, 800000 })
+	{
+		const vector<Triangle> triangles = makeSmallTrianglesScene(count, 0.01f);
+		GeometryProcessor geometryProcessor(&jobSystem);
+		TileRasterizer rasterizer(jobSystem);
+		StreamRenderer streamRenderer(jobSystem);
+		vector<TriangleP> screenTriangles;
+		row("soup", triangles.size(), [&]
+		{
+			geometryProcessor.process(screenTriangles, triangles, mat4(1.0f), view, projection, width - 1, height - 1);
+			rasterizer.rasterize(screenTriangles, frameBuffer);
+		}, [&]
+		{
+			streamRenderer.draw(triangles, GouraudShader(), mat4(1.0f), view, projection, width - 1, height - 1, frameBuffer);
+		}, geometryProcessor, screenTriangles, rasterizer, streamRenderer);
+	}
+	for (const int rings : { 120, 240, 480 })
+	{
+		Mesh mesh = makeSphereMesh(rings, 2 * rings);
+		optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+		GeometryOptions options;
+		options.cullMode = CullMode::BACK;
+		GeometryProcessor geometryProcessor(&jobSystem);
+		TileRasterizer rasterizer(jobSystem);
+		StreamRenderer streamRenderer(jobSystem);
+		vector<TriangleP> screenTriangles;
+		row("sphere", mesh.getTriangleCount(), [&]
+		{
+			geometryProcessor.process(screenTriangles, mesh, mat4(1.0f), view, projection, width - 1, height - 1, options);
+			rasterizer.rasterize(screenTriangles, frameBuffer);
+		}, [&]
+		{
+			streamRenderer.draw(mesh, GouraudShader(), mat4(1.0f), view, projection, width - 1, height - 1, frameBuffer, options);
+		}, geometryProcessor, screenTriangles, rasterizer, streamRenderer);
+	}
+}
+
+// the built-in shaders on a sphere filling most of the screen: each draw runs the batch and raster loops compiled
+// for its shader, the cost grows with the varyings interpolated and the work of the fragment stage
+void benchShaders()
+{
+	const int width = 1920, height = 1080, iterations = 10;
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	const mat4 model = rotate(mat4(1.0f), radians(30.0f), vec3(0, 1, 0)) * scale(mat4(1.0f), vec3(1.5f));
+	Mesh mesh = makeSphereMesh(240, 480);
+	optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+	const Texture texture = makeCheckerTexture(9, 16);
+	const Texture cutoutTexture = makeCheckerTexture(9, 16, true);
+	GeometryOptions options;
+	options.cullMode = CullMode::BACK;
+
+	JobSystem jobSystem;
+	FrameBuffer frameBuffer(width, height);
+	printf("%zu triangles, %dx%d, %d threads, %d iterations\n", mesh.getTriangleCount(), width, height, jobSystem.getThreadCount(), iterations);
+	printf("%-10s %10s %6s %12s %12s %10s\n", "shader", "varyings", "depth", "covered", "shaded", "ms");
+	const double clearMs = timeMs(iterations, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+	const auto row = [&](const char* name, const auto& shader)
+	{
+		using Shader = typename std::decay<decltype(shader)>::type;
+		StreamRendererT<typename Shader::Varyings> renderer(jobSystem);
+		const double ms = timeMs(iterations, [&]
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			renderer.draw(mesh, shader, model, view, projection, width - 1, height - 1, frameBuffer, options);
+		}) - clearMs;
+		RasterStats stats;
+		frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+		renderer.draw(mesh, shader, model, view, projection, width - 1, height - 1, frameBuffer, options, nullptr, &stats);
+		printf("%-10s %10d %6s %12llu %12llu %10.3f\n", name, VaryingLayout<typename Shader::Varyings>::COUNT,
+			Shader::DEPTH_TEST == DepthTest::EARLY ? "early" : "late", static_cast<unsigned long long>(stats.pixelsCovered),
+			static_cast<unsigned long long>(stats.pixelsShaded), ms);
+	};
+	row("flat", FlatShader(vec3(0.8f, 0.5f, 0.2f)));
+	row("gouraud", GouraudShader());
+	row("textured", TexturedShader(texture));
+	row("cutout", CutoutShader(cutoutTexture));
+	row("lambert", LambertShader(model, vec3(1.0f, 1.0f, 1.0f)));
+}
+
+// hi-Z occlusion on scenes without overdraw and with 8 layers drawn front to back / back to front
+void benchHiZ()
+{
+	const int width = 1920, height = 1080, frames = 10;
+	struct Scene
+	{
+		const char* name;
+		vector<Triangle> triangles;
+	};
+	const Scene scenes[] = {
+		{ "200k small", makeSmallTrianglesScene(200000, 0.02f) },
+		{ "20k medium", makeSmallTrianglesScene(20000, 0.2f) },
+		{ "layers f2b", makeLayersScene(8, 200000, true) },
+		{ "layers b2f", makeLayersScene(8, 200000, false) },
+		{ "large f2b", makeLayersScene(8, 2000, true) },
+	};
+
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	FrameBuffer frameBuffer(width, height);
+	JobSystem jobSystem;
+	TileRasterizer rasterizer(jobSystem);
+	printf("%dx%d, %d frames, %d threads\n", width, height, frames, jobSystem.getThreadCount());
+	printf("%-12s %10s %10s %8s %12s %12s\n", "scene", "off ms", "hi-Z ms", "speedup", "shaded", "8x8 occluded");
+	for (const Scene& scene : scenes)
+	{
+		vector<TriangleP> screenTriangles;
+		geometryProcess(screenTriangles, scene.triangles, mat4(1.0f), view, projection, width - 1, height - 1);
+		const auto run = [&](const bool hiZ)
+		{
+			frameBuffer.setHiZEnabled(hiZ);
+			const double clearMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+			return timeMs(frames, [&]
+			{
+				frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+				rasterizer.rasterize(screenTriangles, frameBuffer);
+			}) - clearMs;
+		};
+		const double offMs = run(false), hiZMs = run(true);
+		RasterStats stats;
+		frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+		rasterizer.rasterize(screenTriangles, frameBuffer, &stats);
+		printf("%-12s %10.3f %10.3f %8.2f %12llu %12llu\n", scene.name, offMs, hiZMs, offMs / hiZMs,
+			static_cast<unsigned long long>(stats.pixelsShaded), static_cast<unsigned long long>(stats.blocksOccluded));
+	}
+}
+
+// a street level view over a city block grid: the buildings are the occluders, the detailed props between them are
+// mostly hidden. every mesh drawn vs the meshes whose bounds pass the occlusion test, same image
+void benchOcclusion()
+{
+	const int width = 1920, height = 1080, frames = 10;
+	const CityScene scene = makeCityScene(12, 10);
+	const mat4& view = scene.view;
+	const mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+	GeometryOptions options;
+	options.cullMode = CullMode::BACK;
+	JobSystem jobSystem;
+	StreamRenderer renderer(jobSystem);
+	OcclusionCuller culler;
+	FrameBuffer frameBuffer(width, height);
+	size_t triangles = 0;
+	for (const SceneObject& object : scene.objects)
+	{
+		triangles += scene.meshes[object.mesh].getTriangleCount();
+	}
+	printf("%zu meshes, %zu triangles, %dx%d, %dx%d occlusion buffer, %d threads, %d frames\n", scene.objects.size(), triangles,
+		width, height, culler.getWidth(), culler.getHeight(), jobSystem.getThreadCount(), frames);
+
+	const auto addOccluders = [&]
+	{
+		culler.begin(view, projection);
+		for (const SceneObject& object : scene.objects)
+		{
+			if (object.occluder)
+			{
+				culler.addOccluder(scene.meshes[object.mesh], object.model);
+			}
+		}
+	};
+	size_t drawn = 0;
+	const auto frame = [&](const bool cull)
+	{
+		frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+		if (cull)
+		{
+			addOccluders();
+		}
+		drawn = 0;
+		for (const SceneObject& object : scene.objects)
+		{
+			if (!cull || culler.isVisible(object.bounds, object.model))
+			{
+				renderer.draw(scene.meshes[object.mesh], GouraudShader(), object.model, view, projection, width - 1, height - 1, frameBuffer, options);
+				drawn++;
+			}
+		}
+	};
+	const double clearMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+	const double allMs = timeMs(frames, [&] { frame(false); }) - clearMs;
+	const size_t allDrawn = drawn;
+	frameBuffer.resolveClear();
+	const vector<uint32_t> reference(frameBuffer.colorData(), frameBuffer.colorData() + frameBuffer.getPitch() * height);
+	const double culledMs = timeMs(frames, [&] { frame(true); }) - clearMs;
+	frameBuffer.resolveClear();
+	const bool same = equal(reference.begin(), reference.end(), frameBuffer.colorData());
+	const double occludersMs = timeMs(frames, addOccluders);
+	const OcclusionStats& stats = culler.getStats();
+	printf("%-10s %8s %10s\n", "", "drawn", "ms");
+	printf("%-10s %8zu %10.3f\n", "all", allDrawn, allMs);
+	printf("%-10s %8zu %10.3f\n", "culled", drawn, culledMs);
+	printf("speedup %.2f, occluders %.3f ms (%zu triangles, %zu skipped), same image: %s\n", allMs / culledMs, occludersMs,
+		stats.occluderTriangles, stats.occluderTrianglesSkipped, same ? "yes" : "NO");
+}
+
+// Z-prepass vs one pass on 8 spheres stacked in depth, drawn back to front (every layer shaded by one pass) and
+// front to back (hi-Z and early-Z already reject the hidden ones): the prepass pays when the overdraw of the
+// shading is worth a second geometry and coverage pass
+void benchPrepass()
+{
+	const int width = 1920, height = 1080, frames = 10;
+	mat4 view, projection;
+	sceneCamera(width, height, view, projection);
+	Mesh mesh = makeSphereMesh(48, 96, 0.9f);
+	optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+	vector<mat4> models;
+	for (int layer = 0; layer < 8; layer++)
+	{
+		models.push_back(translate(mat4(1.0f), vec3(0.1f * layer, 0.05f * layer, -0.4f * layer)));
+	}
+	GeometryOptions options;
+	options.cullMode = CullMode::BACK;
+
+	JobSystem jobSystem;
+	FrameBuffer frameBuffer(width, height);
+	printf("8 x %zu triangles, %dx%d, %d threads, %d frames\n", mesh.getTriangleCount(), width, height, jobSystem.getThreadCount(), frames);
+	printf("%-9s %-5s %10s %10s %8s %10s %10s %10s\n", "shader", "order", "1 pass ms", "prepass ms", "speedup", "covered",
+		"1 pass", "prepass");
+	const double clearMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+	const auto row = [&](const char* name, const auto& shader)
+	{
+		using Shader = typename std::decay<decltype(shader)>::type;
+		StreamRendererT<typename Shader::Varyings> renderer(jobSystem);
+		for (const bool frontToBack : { false, true })
+		{
+			const auto drawScene = [&](const auto& passShader, RasterStats* stats)
+			{
+				for (size_t i = 0; i < models.size(); i++)
+				{
+					const mat4& model = models[frontToBack ? i : models.size() - 1 - i];
+					renderer.draw(mesh, passShader, model, view, projection, width - 1, height - 1, frameBuffer, options, nullptr, stats);
+				}
+			};
+			const auto onePass = [&](RasterStats* stats)
+			{
+				frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+				drawScene(shader, stats);
+			};
+			const auto prepass = [&](RasterStats* depthStats, RasterStats* colorStats)
+			{
+				frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+				drawScene(DepthOnlyShader<Shader>(shader), depthStats);
+				drawScene(DepthEqualShader<Shader>(shader), colorStats);
+			};
+			const double onePassMs = timeMs(frames, [&] { onePass(nullptr); }) - clearMs;
+			const double prepassMs = timeMs(frames, [&] { prepass(nullptr, nullptr); }) - clearMs;
+			RasterStats onePassStats, depthStats, colorStats;
+			onePass(&onePassStats);
+			frameBuffer.resolveClear();
+			const vector<uint32_t> reference(frameBuffer.colorData(), frameBuffer.colorData() + frameBuffer.getPitch() * height);
+			prepass(&depthStats, &colorStats);
+			frameBuffer.resolveClear();
+			const bool same = equal(reference.begin(), reference.end(), frameBuffer.colorData());
+			printf("%-9s %-5s %10.3f %10.3f %8.2f %10llu %10llu %10llu%s\n", name, frontToBack ? "f2b" : "b2f", onePassMs, prepassMs,
+				onePassMs / prepassMs, static_cast<unsigned long long>(onePassStats.pixelsCovered),
+				static_cast<unsigned long long>(onePassStats.pixelsShaded), static_cast<unsigned long long>(colorStats.pixelsShaded),
+				same ? "" : "  IMAGE DIFFERS");
+		}
+	};
+	row("gouraud", GouraudShader());
+	row("lambert", LambertShader(mat4(1.0f), vec3(1.0f, 1.0f, 1.0f)));
+}
+
+// fast clear vs writing every pixel (clear then resolveClear, the cost of the clear before the flags), alone and in
+// a frame where a sphere covers part of the screen: the blocks it never touches are neither cleared nor read back
+void benchClear()
+{
+	const int frames = 20;
+	Mesh mesh = makeSphereMesh(48, 96);
+	optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+	GeometryOptions options;
+	options.cullMode = CullMode::BACK;
+	JobSystem jobSystem;
+	StreamRenderer renderer(jobSystem);
+	printf("%zu triangles sphere, %d threads, %d frames\n", mesh.getTriangleCount(), jobSystem.getThreadCount(), frames);
+	printf("%-16s %10s %10s %12s %12s %12s\n", "target", "full ms", "fast ms", "frame full", "frame fast", "same image");
+	struct Config
+	{
+		const char* name;
+		int width, height;
+		FrameBufferLayout layout;
+	};
+	const Config configs[] = {
+		{ "1080p linear", 1920, 1080, FrameBufferLayout::LINEAR },
+		{ "1080p tiled", 1920, 1080, FrameBufferLayout::TILED },
+		{ "4K linear", 3840, 2160, FrameBufferLayout::LINEAR },
+		{ "4K tiled", 3840, 2160, FrameBufferLayout::TILED },
+	};
+	for (const Config& config : configs)
+	{
+		const int width = config.width, height = config.height;
+		mat4 view, projection;
+		sceneCamera(width, height, view, projection);
+		FrameBuffer frameBuffer(width, height, config.layout);
+		vector<uint8_t> image(3 * width * height), reference(3 * width * height);
+		const double fullMs = timeMs(frames, [&]
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			frameBuffer.resolveClear();
+		});
+		const double fastMs = timeMs(frames, [&] { frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f)); });
+		const auto frame = [&](const bool full, uint8_t* output)
+		{
+			frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+			if (full)
+			{
+				frameBuffer.resolveClear();
+			}
+			renderer.draw(mesh, GouraudShader(), mat4(1.0f), view, projection, width - 1, height - 1, frameBuffer, options);
+			frameBuffer.resolveBGR8(output, &jobSystem);
+		};
+		const double frameFullMs = timeMs(frames, [&] { frame(true, reference.data()); });
+		const double frameFastMs = timeMs(frames, [&] { frame(false, image.data()); });
+		printf("%-16s %10.3f %10.3f %12.3f %12.3f %12s\n", config.name, fullMs, fastMs, frameFullMs, frameFastMs,
+			image == reference ? "yes" : "NO");
+	}
+}
+
+struct Benchmark
+{
+	const char* name;
+	const char* description;
+	void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+	{ "layout", "linear vs tiled framebuffer layout, many small triangles", benchFrameBufferLayout },
+	{ "threads", "serial vs binned multithreaded rasterization", benchRasterThreads },
+	{ "transform", "vertex transform of a 1M vertex mesh, per vertex mvp vs SoA kernel", benchVertexTransform },
+	{ "mesh", "indexed mesh vs triangle soup geometry, vertex cache reordering", benchMesh },
+	{ "guardband", "x / y polygon clipping vs guard band clipping", benchGuardBand },
+	{ "cull", "back / front face culling of a closed mesh", benchCulling },
+	{ "clip", "per triangle vs batched SoA clipping of triangles crossing the near plane", benchClipping },
+	{ "alloc", "heap allocations per frame of the geometry and raster stages", benchAllocations },
+	{ "stream", "whole-scene intermediate arrays vs streamed geometry / raster batches", benchStreaming },
+	{ "shaders", "flat, Gouraud, textured, alpha tested and Lambert shaders on a sphere, early vs late depth test", benchShaders },
+	{ "hiz", "per 8x8 block farthest depth: occluded triangles and blocks skipped, with and without overdraw", benchHiZ },
+	{ "occlusion", "low resolution occluder depth buffer, meshes culled by their bounds before the geometry stages", benchOcclusion },
+	{ "prepass", "Z-prepass (depth only pass, then depth equal color pass) vs one pass, shaded vs covered pixels", benchPrepass },
+	{ "clear", "per tile clear flags vs writing every pixel at 1080p and 4K", benchClear },
+};
+
+int main(int argc, char** argv)
+{
+	vector<const Benchmark*> selected;
+	for (int i = 1; i < argc; i++)
+	{
+		bool found = false;
+		for (const Benchmark& benchmark : benchmarks)
+		{
+			if (strcmp(argv[i], benchmark.name) == 0)
+			{
+				selected.push_back(&benchmark);
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			printf("usage: %s [benchmark ...]\n", argv[0]);
+			for (const Benchmark& benchmark : benchmarks)
+			{
+				printf("  %-12s %s\n", benchmark.name, benchmark.description);
+			}
+			return 1;
+		}
+	}
+	if (selected.empty())
+	{
+		for (const Benchmark& benchmark : benchmarks)
+		{
+			selected.push_back(&benchmark);
+		}
+	}
+
+	for (const Benchmark* benchmark : selected)
+	{
+		printf("==== %s: %s ====\n", benchmark->name, benchmark->description);
+		benchmark->run();
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "clip.h"
+#include "clip_impl.h"
+#include "simd.h"
+#include "shader.h"
+
+using namespace std;
+using namespace glm;
+
+void classifyTriangles(const uint32_t* outcodes0, const uint32_t* outcodes1, const uint32_t* outcodes2, const size_t count,
+					   const bool guardBand, uint32_t* planes)
+{
+	using namespace simd;
+
+	const VInt zero = set1(0);
+	const VInt frustum = set1(static_cast<int32_t>(CLIP_FRUSTUM)), reject = set1(static_cast<int32_t>(CLIP_REJECT));
+	const VInt planesZ = set1(static_cast<int32_t>(CLIP_Z_POSITIVE | CLIP_Z_NEGATIVE));
+	const VInt planesX = set1(static_cast<int32_t>(CLIP_X_POSITIVE | CLIP_X_NEGATIVE));
+	const VInt planesY = set1(static_cast<int32_t>(CLIP_Y_POSITIVE | CLIP_Y_NEGATIVE));
+	const VInt guardX = set1(static_cast<int32_t>(CLIP_GUARD_X)), guardY = set1(static_cast<int32_t>(CLIP_GUARD_Y));
+
+	// same decisions as Clipper::isOutside and Clipper::clipPlanes
+	const auto classify = [&](const uint32_t* o0, const uint32_t* o1, const uint32_t* o2, uint32_t* out)
+	{
+		const VInt a = load(o0), b = load(o1), c = load(o2);
+		const VInt crossed = a | b | c;
+		const VInt outside = andNot(set1(-1), ((a & b & c & frustum) == zero));
+		VInt clip = crossed & frustum;
+		if (guardBand)
+		{
+			clip = (crossed & planesZ) |
+				andNot(crossed & planesX, (crossed & guardX) == zero) |
+				andNot(crossed & planesY, (crossed & guardY) == zero);
+		}
+		store(out, select(outside, reject, clip));
+	};
+
+	size_t i = 0;
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		classify(outcodes0 + i, outcodes1 + i, outcodes2 + i, planes + i);
+	}
+	if (i < count)
+	{
+		uint32_t tail[4][WIDTH] = {};
+		const size_t rest = count - i;
+		for (size_t j = 0; j < rest; j++)
+		{
+			tail[0][j] = outcodes0[i + j];
+			tail[1][j] = outcodes1[i + j];
+			tail[2][j] = outcodes2[i + j];
+		}
+		classify(tail[0], tail[1], tail[2], tail[3]);
+		copy_n(tail[3], rest, planes + i);
+	}
+}
+
+// the layouts of the built-in shaders
+template class BatchClipper<VertexPT<FlatShader::Varyings>>;
+template class BatchClipper<VertexPT<GouraudShader::Varyings>>;
+template class BatchClipper<VertexPT<TexturedShader::Varyings>>;
+template class BatchClipper<VertexPT<LambertShader::Varyings>>;
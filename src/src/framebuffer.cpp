@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+
+#include "framebuffer.h"
+#include "jobsystem.h"
+
+// rows per resolve job, tiles are never split
+static constexpr int RESOLVE_BAND_ROWS = 32;
+
+void FrameBuffer::resize(int width, int height, FrameBufferLayout layout, int tileSize)
+{
+	m_width = width;
+	m_height = height;
+	m_layout = layout;
+
+	size_t rows = height;
+	if (layout == FrameBufferLayout::TILED)
+	{
+		m_tileShift = 0;
+		while ((1 << m_tileShift) < std::max(tileSize, MIN_TILE_SIZE))
+		{
+			m_tileShift++;
+		}
+		const int tile = 1 << m_tileShift;
+		m_pitch = (width + tile - 1) / tile * tile;
+		rows = (height + tile - 1) / tile * tile;
+	}
+	else
+	{
+		m_pitch = (width + PITCH_ALIGNMENT - 1) / PITCH_ALIGNMENT * PITCH_ALIGNMENT;
+	}
+	m_depth.resize(static_cast<size_t>(m_pitch) * rows);
+	m_color.resize(static_cast<size_t>(m_pitch) * rows);
+	m_hiZPitch = (width + HI_Z_BLOCK_SIZE - 1) / HI_Z_BLOCK_SIZE;
+	m_hiZ.resize(static_cast<size_t>(m_hiZPitch) * ((height + HI_Z_BLOCK_SIZE - 1) / HI_Z_BLOCK_SIZE));
+	m_clearPitch = (width + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE;
+	m_clearFlags.resize(static_cast<size_t>(m_clearPitch) * ((height + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE));
+	// the new attachments hold anything: a draw before the first clear must neither test against them nor against a
+	// hi-Z of them
+	clear(DEFAULT_CLEAR_DEPTH, glm::vec3(0.0f));
+}
+
+void FrameBuffer::clear(float depth, const glm::vec3& color)
+{
+	m_clearDepth = depth;
+	m_clearColor = packRGBA8(color);
+	// the bits of the blocks past the right and bottom edges are never looked at
+	std::fill_n(m_clearFlags.data(), m_clearFlags.size(), ~uint64_t(0));
+	// every pixel of a block is at the clear depth, the blocks of the right and bottom edges have fewer
+	const int blocksY = static_cast<int>(m_hiZ.size()) / std::max(m_hiZPitch, 1);
+	for (int y = 0; y < blocksY; y++)
+	{
+		const int rows = std::min(HI_Z_BLOCK_SIZE, m_height - y * HI_Z_BLOCK_SIZE);
+		for (int x = 0; x < m_hiZPitch; x++)
+		{
+			const int columns = std::min(HI_Z_BLOCK_SIZE, m_width - x * HI_Z_BLOCK_SIZE);
+			m_hiZ[static_cast<size_t>(y) * m_hiZPitch + x] = { depth, rows * columns };
+		}
+	}
+}
+
+void FrameBuffer::resolveClear()
+{
+	for (int blockY = 0; blockY < m_height; blockY += CLEAR_BLOCK_SIZE)
+	{
+		const int rows = std::min(CLEAR_BLOCK_SIZE, m_height - blockY);
+		for (int blockX = 0; blockX < m_width; blockX += CLEAR_BLOCK_SIZE)
+		{
+			uint64_t& flags = m_clearFlags[static_cast<size_t>(blockY / CLEAR_TILE_SIZE) * m_clearPitch + blockX / CLEAR_TILE_SIZE];
+			const uint64_t bit = clearBit(blockX, blockY);
+			if ((flags & bit) == 0)
+			{
+				continue;
+			}
+			flags &= ~bit;
+			// whole rows of the block: the rows are padded to whole blocks
+			for (int row = 0; row < rows; row++)
+			{
+				const size_t index = offset(blockX, blockY + row);
+				std::fill_n(m_depth.data() + index, CLEAR_BLOCK_SIZE, m_clearDepth);
+				std::fill_n(m_color.data() + index, CLEAR_BLOCK_SIZE, m_clearColor);
+			}
+		}
+	}
+}
+
+// rowFn(y, x, src, count) for the pixels x..x + count - 1 of row y starting at src, split where the pending clear
+// flags change: src is nullptr for the runs of cleared blocks, whose pixels are the clear color
+template<typename RowFn>
+static void splitClearedRuns(const FrameBuffer& frameBuffer, const int y, const int x, const uint32_t* src, const int count, RowFn& rowFn)
+{
+	constexpr int BLOCK = FrameBuffer::CLEAR_BLOCK_SIZE;
+	int runX = x;
+	bool runCleared = frameBuffer.isCleared(x, y);
+	for (int blockX = (x / BLOCK + 1) * BLOCK; blockX < x + count; blockX += BLOCK)
+	{
+		const bool cleared = frameBuffer.isCleared(blockX, y);
+		if (cleared != runCleared)
+		{
+			rowFn(y, runX, runCleared ? nullptr : src + (runX - x), blockX - runX);
+			runX = blockX;
+			runCleared = cleared;
+		}
+	}
+	rowFn(y, runX, runCleared ? nullptr : src + (runX - x), x + count - runX);
+}
+
+// calls rowFn(y, x, src, count) for contiguous runs of source pixels of the rows yBegin..yEnd - 1, count <= width - x, src nullptr
+// for the runs of pending clear.
+// for TILED, yBegin is a multiple of the tile size
+template<typename RowFn>
+static void forEachColorRun(const FrameBuffer& frameBuffer, const int yBegin, const int yEnd, RowFn rowFn)
+{
+	const int width = frameBuffer.getWidth();
+	const uint32_t* color = frameBuffer.colorData();
+	if (frameBuffer.getLayout() == FrameBufferLayout::LINEAR)
+	{
+		const int pitch = frameBuffer.getPitch();
+		for (int y = yBegin; y < yEnd; y++)
+		{
+			splitClearedRuns(frameBuffer, y, 0, color + static_cast<size_t>(y) * pitch, width, rowFn);
+		}
+		return;
+	}
+	// walk whole tiles so the source is read strictly sequentially
+	const int tile = frameBuffer.getTileSize();
+	const int tilesX = frameBuffer.getPitch() / tile;
+	const size_t tilePixels = static_cast<size_t>(tile) * tile;
+	for (int ty = yBegin / tile; ty * tile < yEnd; ty++)
+	{
+		const int rows = std::min(tile, yEnd - ty * tile);
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			const uint32_t* src = color + (static_cast<size_t>(ty) * tilesX + tx) * tilePixels;
+			const int count = std::min(tile, width - tx * tile);
+			for (int r = 0; r < rows; r++)
+			{
+				splitClearedRuns(frameBuffer, ty * tile + r, tx * tile, src + r * tile, count, rowFn);
+			}
+		}
+	}
+}
+
+// forEachColorRun over all rows, in bands of whole tiles on the job system when there is one
+template<typename RowFn>
+static void forEachColorBand(const FrameBuffer& frameBuffer, JobSystem* jobSystem, RowFn rowFn)
+{
+	const int height = frameBuffer.getHeight();
+	if (jobSystem == nullptr)
+	{
+		forEachColorRun(frameBuffer, 0, height, rowFn);
+		return;
+	}
+	const int bandRows = frameBuffer.getLayout() == FrameBufferLayout::TILED ?
+		std::max(frameBuffer.getTileSize(), RESOLVE_BAND_ROWS) : RESOLVE_BAND_ROWS;
+	const size_t bands = (height + bandRows - 1) / bandRows;
+	jobSystem->parallelFor(0, bands, 1, [&](size_t begin, size_t end, int)
+	{
+		forEachColorRun(frameBuffer, static_cast<int>(begin) * bandRows, std::min(static_cast<int>(end) * bandRows, height), rowFn);
+	});
+}
+
+void FrameBuffer::resolveRGBA8(uint8_t* dst, JobSystem* jobSystem) const
+{
+	uint32_t* out = reinterpret_cast<uint32_t*>(dst);
+	const size_t width = m_width;
+	forEachColorBand(*this, jobSystem, [&](int y, int x, const uint32_t* src, int count)
+	{
+		if (src == nullptr)
+		{
+			std::fill_n(out + y * width + x, count, m_clearColor);
+			return;
+		}
+		std::memcpy(out + y * width + x, src, count * sizeof(uint32_t));
+	});
+}
+
+void FrameBuffer::resolveBGR8(uint8_t* dst, JobSystem* jobSystem) const
+{
+	const size_t width = m_width;
+	forEachColorBand(*this, jobSystem, [&](int y, int x, const uint32_t* src, int count)
+	{
+		uint8_t* out = dst + (y * width + x) * 3;
+		for (int i = 0; i < count; i++, out += 3)
+		{
+			const uint32_t c = src != nullptr ? src[i] : m_clearColor;
+			out[0] = static_cast<uint8_t>(c >> 16);
+			out[1] = static_cast<uint8_t>(c >> 8);
+			out[2] = static_cast<uint8_t>(c);
+		}
+	});
+}
@@ -0,0 +1,475 @@
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <tgaimage.h>
+
+#include "vertex.h"
+#include "render.h"
+#include "scene.h"
+#include "jobsystem.h"
+#include "mesh.h"
+#include "shader.h"
+#include "occlusion.h"
+
+using namespace std;
+using namespace glm;
+
+// ======== headless ========
+
+struct HeadlessOptions
+{
+	int width = 800;
+	int height = 600;
+	int frames = 100;
+	string output = "output/output.tga";
+	bool dumpFrames = false;
+	string scene = "triangle";
+	int triangles = 100000;
+	bool reorder = false;
+	bool stream = false;
+	string shader = "gouraud";
+	GeometryOptions geometry;
+	FrameBufferLayout layout = FrameBufferLayout::LINEAR;
+	int tileSize = FrameBuffer::DEFAULT_TILE_SIZE;
+	bool hiZ = true;
+	bool prepass = false;
+	bool occlusion = false;
+	// 0: one per hardware thread
+	int threads = 0;
+	bool pinThreads = false;
+};
+
+void printUsage(const char* exe)
+{
+	std::cout << "usage: " << exe << " [options]\n"
+		"  --frames N      number of frames to render (default 100)\n"
+		"  --width W       framebuffer width (default 800)\n"
+		"  --height H      framebuffer height (default 600)\n"
+		"  --output FILE   tga file of the last frame (default output/output.tga)\n"
+		"  --dump-frames   also write every frame as FILE_NNNN.tga\n"
+		"  --scene NAME    triangle | small | sphere | layers | city, city implies --stream (default triangle)\n"
+		"  --triangles N   triangle count of the small, sphere and layers scenes (default 100000)\n"
+		"  --reorder       reorder the sphere's indices for the post-transform vertex cache\n"
+		"  --no-guard-band clip every triangle crossing the x / y frustum planes\n"
+		"  --cull NAME     none | back | front (default none)\n"
+		"  --front-face W  winding of front faces: ccw | cw (default ccw)\n"
+		"  --stream        stream batches from geometry to raster instead of whole-scene arrays\n"
+		"  --shader NAME   flat | gouraud | textured | cutout | lambert, other than gouraud implies --stream (default gouraud)\n"
+		"  --layout NAME   framebuffer layout: linear | tiled (default linear)\n"
+		"  --tile N        tile size of the tiled layout (default 8)\n"
+		"  --no-hi-z       test every 8x8 block against the depth buffer, no per block farthest depth\n"
+		"  --prepass       Z-prepass: a depth only pass, then a color pass shading the pixels of equal depth\n"
+		"  --occlusion     city: skip the meshes an occlusion buffer of the buildings shows hidden\n"
+		"  --threads N     worker threads, 0 for one per hardware thread (default 0)\n"
+		"  --pin           pin worker i to logical cpu i\n";
+}
+
+bool parseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--frames") == 0 && hasValue)
+		{
+			options.frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--width") == 0 && hasValue)
+		{
+			options.width = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--height") == 0 && hasValue)
+		{
+			options.height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && hasValue)
+		{
+			options.output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--dump-frames") == 0)
+		{
+			options.dumpFrames = true;
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+		{
+			options.scene = argv[++i];
+			if (options.scene != "triangle" && options.scene != "small" && options.scene != "sphere" && options.scene != "layers"
+				&& options.scene != "city")
+			{
+				return false;
+			}
+			// many meshes, each drawn with its own model matrix
+			options.stream = options.stream || options.scene == "city";
+		}
+		else if (strcmp(argv[i], "--triangles") == 0 && hasValue)
+		{
+			options.triangles = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--reorder") == 0)
+		{
+			options.reorder = true;
+		}
+		else if (strcmp(argv[i], "--no-guard-band") == 0)
+		{
+			options.geometry.guardBand = false;
+		}
+		else if (strcmp(argv[i], "--no-hi-z") == 0)
+		{
+			options.hiZ = false;
+		}
+		else if (strcmp(argv[i], "--prepass") == 0)
+		{
+			options.prepass = true;
+		}
+		else if (strcmp(argv[i], "--occlusion") == 0)
+		{
+			options.occlusion = true;
+		}
+		else if (strcmp(argv[i], "--cull") == 0 && hasValue)
+		{
+			const string cull = argv[++i];
+			if (cull != "none" && cull != "back" && cull != "front")
+			{
+				return false;
+			}
+			options.geometry.cullMode = cull == "back" ? CullMode::BACK : cull == "front" ? CullMode::FRONT : CullMode::NONE;
+		}
+		else if (strcmp(argv[i], "--front-face") == 0 && hasValue)
+		{
+			const string frontFace = argv[++i];
+			if (frontFace != "ccw" && frontFace != "cw")
+			{
+				return false;
+			}
+			options.geometry.frontFace = frontFace == "cw" ? FrontFace::CLOCKWISE : FrontFace::COUNTER_CLOCKWISE;
+		}
+		else if (strcmp(argv[i], "--stream") == 0)
+		{
+			options.stream = true;
+		}
+		else if (strcmp(argv[i], "--shader") == 0 && hasValue)
+		{
+			options.shader = argv[++i];
+			if (options.shader != "flat" && options.shader != "gouraud" && options.shader != "textured" && options.shader != "cutout"
+				&& options.shader != "lambert")
+			{
+				return false;
+			}
+			// GeometryProcessor and TileRasterizer run the fixed function stages only
+			options.stream = options.stream || options.shader != "gouraud";
+		}
+		else if (strcmp(argv[i], "--layout") == 0 && hasValue)
+		{
+			const string layout = argv[++i];
+			if (layout != "linear" && layout != "tiled")
+			{
+				return false;
+			}
+			options.layout = layout == "tiled" ? FrameBufferLayout::TILED : FrameBufferLayout::LINEAR;
+		}
+		else if (strcmp(argv[i], "--tile") == 0 && hasValue)
+		{
+			options.tileSize = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+		{
+			options.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--pin") == 0)
+		{
+			options.pinThreads = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return options.frames > 0 && options.width > 0 && options.height > 0 && options.triangles > 0 && options.tileSize > 0 && options.threads >= 0 &&
+		(!options.occlusion || options.scene == "city");
+}
+
+string frameFileName(const string& output, const int frame)
+{
+	string stem = output;
+	const size_t dot = stem.rfind('.');
+	if (dot != string::npos && stem.find('/', dot) == string::npos)
+	{
+		stem = stem.substr(0, dot);
+	}
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), "_%04d.tga", frame);
+	return stem + suffix;
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+	const int width = options.width, height = options.height;
+
+	// viewport
+	FrameBuffer frameBuffer(width, height, options.layout, options.tileSize);
+	frameBuffer.setHiZEnabled(options.hiZ);
+	TGAImage image(width, height, TGAImage::RGB);
+	JobSystem jobSystem(options.threads, options.pinThreads);
+	GeometryProcessor geometryProcessor(&jobSystem);
+	TileRasterizer rasterizer(jobSystem);
+	StreamRenderer streamRenderer(jobSystem);
+	StreamRendererT<FlatShader::Varyings> flatRenderer(jobSystem);
+	StreamRendererT<TexturedShader::Varyings> texturedRenderer(jobSystem);
+	StreamRendererT<LambertShader::Varyings> lambertRenderer(jobSystem);
+
+	// data
+	const bool indexed = options.scene == "sphere";
+	const vector<Triangle> triangles = options.scene == "small" ? makeSmallTrianglesScene(options.triangles, 0.02f) :
+		options.scene == "layers" ? makeLayersScene(8, options.triangles) : indexed ? vector<Triangle>() : makeTriangleScene();
+	Mesh mesh;
+	if (indexed)
+	{
+		// about 4 * rings^2 triangles
+		const int rings = std::max(2, static_cast<int>(sqrt(options.triangles / 4.0)));
+		mesh = makeSphereMesh(rings, 2 * rings);
+		printf("sphere: %zu vertices, %zu triangles, ACMR %.3f", mesh.getVertexCount(), mesh.getTriangleCount(),
+			computeACMR(mesh.indices, mesh.getVertexCount(), VERTEX_CACHE_SIZE));
+		if (options.reorder)
+		{
+			optimizeVertexCache(mesh.indices, mesh.getVertexCount());
+			printf(", reordered %.3f", computeACMR(mesh.indices, mesh.getVertexCount(), VERTEX_CACHE_SIZE));
+		}
+		printf("\n");
+	}
+	// the city: its meshes drawn each frame, all of them or the ones the occluders leave visible
+	const bool city = options.scene == "city";
+	const CityScene cityScene = city ? makeCityScene(12, 10) : CityScene();
+	vector<const SceneObject*> cityObjects;
+	OcclusionCuller culler;
+	size_t cityDrawn = 0;
+	size_t triangleCount = indexed ? mesh.getTriangleCount() : triangles.size();
+	for (const SceneObject& object : cityScene.objects)
+	{
+		triangleCount += cityScene.meshes[object.mesh].getTriangleCount();
+	}
+	vector<TriangleP> screenTriangles;
+
+	// set mvp matrix
+	mat4 model = mat4(1.0);
+	mat4 view = city ? cityScene.view : lookAt(vec3(0, 0, 3), vec3(0, 0, 0), vec3(0, 1, 0));
+	mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+
+	// the sphere has the normals and uvs of the textured and lambert shaders
+	const Texture texture = makeCheckerTexture(9, 16);
+	const Texture cutoutTexture = makeCheckerTexture(9, 16, true);
+	// the depth only pass of --prepass, counted apart from the color pass
+	RasterStats prepassStats;
+	const auto streamDraw = [&](auto& renderer, const auto& shader, GeometryStats* geometryStats, RasterStats* rasterStats)
+	{
+		const auto draw = [&](const auto& passShader, RasterStats* passStats)
+		{
+			if (city)
+			{
+				for (const SceneObject* object : cityObjects)
+				{
+					renderer.draw(cityScene.meshes[object->mesh], passShader, object->model, view, projection, width - 1, height - 1, frameBuffer,
+						options.geometry, geometryStats, passStats);
+				}
+			}
+			else if (indexed)
+			{
+				renderer.draw(mesh, passShader, model, view, projection, width - 1, height - 1, frameBuffer, options.geometry, geometryStats, passStats);
+			}
+			else
+			{
+				renderer.draw(triangles, passShader, model, view, projection, width - 1, height - 1, frameBuffer, options.geometry, geometryStats, passStats);
+			}
+		};
+		using Shader = typename std::decay<decltype(shader)>::type;
+		if (options.prepass)
+		{
+			draw(DepthOnlyShader<Shader>(shader), &prepassStats);
+			draw(DepthEqualShader<Shader>(shader), rasterStats);
+		}
+		else
+		{
+			draw(shader, rasterStats);
+		}
+	};
+
+	using Clock = chrono::steady_clock;
+	auto toMs = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+	vector<double> frameTimes(options.frames);
+	RasterStats rasterStats;
+	GeometryStats geometryStats;
+	double clearTotal = 0, geometryTotal = 0, rasterTotal = 0, resolveTotal = 0;
+	vector<WorkerStats> workerTotals(jobSystem.getThreadCount());
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		jobSystem.resetStats();
+		const auto t0 = Clock::now();
+		frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+		const auto t1 = Clock::now();
+		// geometry process
+		if (city)
+		{
+			// the occlusion culling before the batches, timed as geometry
+			if (options.occlusion)
+			{
+				culler.begin(view, projection);
+				for (const SceneObject& object : cityScene.objects)
+				{
+					if (object.occluder)
+					{
+						culler.addOccluder(cityScene.meshes[object.mesh], object.model);
+					}
+				}
+			}
+			cityObjects.clear();
+			for (const SceneObject& object : cityScene.objects)
+			{
+				if (!options.occlusion || culler.isVisible(object.bounds, object.model))
+				{
+					cityObjects.push_back(&object);
+				}
+			}
+			cityDrawn += cityObjects.size();
+		}
+		else if (options.stream)
+		{
+			// nothing to time apart, the batches go through geometry and raster together
+		}
+		else if (indexed)
+		{
+			geometryProcessor.process(screenTriangles, mesh, model, view, projection, width - 1, height - 1, options.geometry, &geometryStats);
+		}
+		else
+		{
+			geometryProcessor.process(screenTriangles, triangles, model, view, projection, width - 1, height - 1, options.geometry, &geometryStats);
+		}
+		const auto t2 = Clock::now();
+		// rasterization and pix process
+		if (options.stream && options.shader == "flat")
+		{
+			streamDraw(flatRenderer, FlatShader(vec3(0.8f, 0.5f, 0.2f)), &geometryStats, &rasterStats);
+		}
+		else if (options.stream && options.shader == "textured")
+		{
+			streamDraw(texturedRenderer, TexturedShader(texture), &geometryStats, &rasterStats);
+		}
+		else if (options.stream && options.shader == "cutout")
+		{
+			streamDraw(texturedRenderer, CutoutShader(cutoutTexture), &geometryStats, &rasterStats);
+		}
+		else if (options.stream && options.shader == "lambert")
+		{
+			streamDraw(lambertRenderer, LambertShader(model, vec3(1.0f, 1.0f, 1.0f)), &geometryStats, &rasterStats);
+		}
+		else if (options.stream)
+		{
+			streamDraw(streamRenderer, GouraudShader(), &geometryStats, &rasterStats);
+		}
+		else if (options.prepass)
+		{
+			rasterizer.rasterize(screenTriangles, frameBuffer, &prepassStats, DepthPass::DEPTH_ONLY);
+			rasterizer.rasterize(screenTriangles, frameBuffer, &rasterStats, DepthPass::EQUAL);
+		}
+		else
+		{
+			rasterizer.rasterize(screenTriangles, frameBuffer, &rasterStats);
+		}
+		const auto t3 = Clock::now();
+		frameBuffer.resolveBGR8(image.buffer(), &jobSystem);
+		const auto t4 = Clock::now();
+
+		// load balance: busy time of the least and the most loaded worker
+		const vector<WorkerStats> workerStats = jobSystem.getStats();
+		double busyMin = workerStats[0].busyMs, busyMax = workerStats[0].busyMs;
+		for (size_t worker = 0; worker < workerStats.size(); worker++)
+		{
+			busyMin = std::min(busyMin, workerStats[worker].busyMs);
+			busyMax = std::max(busyMax, workerStats[worker].busyMs);
+			workerTotals[worker].jobs += workerStats[worker].jobs;
+			workerTotals[worker].steals += workerStats[worker].steals;
+			workerTotals[worker].busyMs += workerStats[worker].busyMs;
+			workerTotals[worker].idleMs += workerStats[worker].idleMs;
+		}
+
+		clearTotal += toMs(t1 - t0);
+		geometryTotal += toMs(t2 - t1);
+		rasterTotal += toMs(t3 - t2);
+		resolveTotal += toMs(t4 - t3);
+		frameTimes[frame] = toMs(t4 - t0);
+
+		printf("frame %4d: %8.3f ms (clear %.3f, geometry %.3f, raster %.3f, resolve %.3f, worker busy %.3f..%.3f)\n",
+			frame, frameTimes[frame], toMs(t1 - t0), toMs(t2 - t1), toMs(t3 - t2), toMs(t4 - t3), busyMin, busyMax);
+
+		if (options.dumpFrames)
+		{
+			image.write_tga_file(frameFileName(options.output, frame));
+		}
+	}
+
+	const double frames = options.frames;
+	const double total = clearTotal + geometryTotal + rasterTotal + resolveTotal;
+	const auto minmax = minmax_element(frameTimes.begin(), frameTimes.end());
+	printf("\n%d frames at %dx%d, %zu triangles, %s layout, %d threads\n", options.frames, width, height, triangleCount,
+		options.layout == FrameBufferLayout::TILED ? "tiled" : "linear", jobSystem.getThreadCount());
+	printf("frame    avg %8.3f ms  min %8.3f ms  max %8.3f ms  (%.1f FPS)\n",
+		total / frames, *minmax.first, *minmax.second, 1000.0 * frames / total);
+	printf("clear    avg %8.3f ms\n", clearTotal / frames);
+	printf("geometry avg %8.3f ms\n", geometryTotal / frames);
+	printf("raster   avg %8.3f ms%s\n", rasterTotal / frames, options.stream ? " (streamed, geometry included)" : "");
+	printf("resolve  avg %8.3f ms\n", resolveTotal / frames);
+
+	const auto perFrame = [&](uint64_t count) { return static_cast<double>(count) / frames; };
+	printf("\nper frame: %.0f triangles in, %.0f trivially rejected, %.0f clipped, %.0f culled, %.0f degenerate, %.0f out (guard band %s)\n",
+		perFrame(geometryStats.triangles), perFrame(geometryStats.trivialRejected), perFrame(geometryStats.clipped),
+		perFrame(geometryStats.culled), perFrame(geometryStats.degenerate), perFrame(geometryStats.output),
+		options.geometry.guardBand ? "on" : "off");
+	printf("per frame: %.0f triangles rasterized in %.0f bins\n", perFrame(rasterStats.triangles), perFrame(rasterStats.binnedTriangles));
+	printf("64x64 blocks  %12.0f rejected %12.0f accepted\n", perFrame(rasterStats.coarseBlocksRejected), perFrame(rasterStats.coarseBlocksAccepted));
+	printf("8x8 blocks    %12.0f rejected %12.0f accepted %12.0f partial\n",
+		perFrame(rasterStats.blocksRejected), perFrame(rasterStats.blocksAccepted), perFrame(rasterStats.blocksPartial));
+	printf("pixels        %12.0f tested   %12.0f covered  %12.0f shaded\n", perFrame(rasterStats.pixelsTested), perFrame(rasterStats.pixelsCovered),
+		perFrame(rasterStats.pixelsShaded));
+	if (options.prepass)
+	{
+		printf("depth pass    %12.0f tested   %12.0f covered  %12.0f shaded\n", perFrame(prepassStats.pixelsTested),
+			perFrame(prepassStats.pixelsCovered), perFrame(prepassStats.pixelsShaded));
+	}
+	if (city)
+	{
+		printf("meshes        %12.0f drawn of %zu (occlusion culling %s, %zu occluder triangles, %zu skipped)\n", perFrame(cityDrawn),
+			cityScene.objects.size(), options.occlusion ? "on" : "off", culler.getStats().occluderTriangles, culler.getStats().occluderTrianglesSkipped);
+	}
+	printf("hi-Z occluded %12.0f triangles %10.0f 64x64 %12.0f 8x8 (%s)\n", perFrame(rasterStats.trianglesOccluded),
+		perFrame(rasterStats.coarseBlocksOccluded), perFrame(rasterStats.blocksOccluded), options.hiZ ? "on" : "off");
+	printf("intermediate buffers %.1f KB\n", (options.stream ?
+		streamRenderer.getBufferBytes() + flatRenderer.getBufferBytes() + texturedRenderer.getBufferBytes() + lambertRenderer.getBufferBytes() :
+		geometryProcessor.getBufferBytes() + screenTriangles.capacity() * sizeof(TriangleP) + rasterizer.getBufferBytes()) / 1024.0);
+
+	printf("\nworker  %10s %10s %10s %10s  (per frame)\n", "jobs", "steals", "busy ms", "idle ms");
+	for (size_t worker = 0; worker < workerTotals.size(); worker++)
+	{
+		printf("%6zu  %10.0f %10.0f %10.3f %10.3f\n", worker, perFrame(workerTotals[worker].jobs), perFrame(workerTotals[worker].steals),
+			workerTotals[worker].busyMs / frames, workerTotals[worker].idleMs / frames);
+	}
+
+	if (!image.write_tga_file(options.output))
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,277 @@
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "jobsystem.h"
+
+using namespace std;
+
+// failed rounds over all deques before an idle worker goes to sleep
+static constexpr int IDLE_SPINS = 64;
+static constexpr size_t INITIAL_QUEUE_CAPACITY = 256;
+
+static thread_local const JobSystem* t_system = nullptr;
+static thread_local int t_worker = 0;
+// jobs running on this thread, nested ones run inline from parallelFor / wait and are not timed twice
+static thread_local int t_depth = 0;
+static thread_local uint32_t t_random = 0x9e3779b9u;
+
+static void pinCurrentThread(int worker)
+{
+	const int cpus = std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	const int cpu = worker % cpus;
+#if defined(_WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (cpu % 64));
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)cpu;
+#endif
+}
+
+JobSystem::JobSystem(int threads, bool pinThreads) : pinThreads(pinThreads)
+{
+	if (threads <= 0)
+	{
+		threads = std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	}
+	threadCount = threads;
+	queues.reset(new WorkerQueue[threadCount]);
+	counters.reset(new WorkerCounters[threadCount]);
+	for (int worker = 0; worker < threadCount; worker++)
+	{
+		queues[worker].jobs.resize(INITIAL_QUEUE_CAPACITY);
+	}
+	resetStats();
+
+	t_system = this;
+	t_worker = 0;
+	if (pinThreads)
+	{
+		pinCurrentThread(0);
+	}
+	for (int worker = 1; worker < threadCount; worker++)
+	{
+		this->threads.emplace_back(&JobSystem::workerLoop, this, worker);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (thread& worker : threads)
+	{
+		worker.join();
+	}
+	if (t_system == this)
+	{
+		t_system = nullptr;
+	}
+}
+
+int JobSystem::currentWorker() const
+{
+	return t_system == this ? t_worker : 0;
+}
+
+void JobSystem::push(const Job& job)
+{
+	WorkerQueue& queue = queues[currentWorker()];
+	{
+		lock_guard<mutex> lock(queue.mutex);
+		if (queue.count == queue.jobs.size())
+		{
+			// unroll the ring into a buffer twice the size
+			vector<Job> grown(queue.jobs.size() * 2);
+			for (size_t i = 0; i < queue.count; i++)
+			{
+				grown[i] = queue.jobs[(queue.head + i) % queue.jobs.size()];
+			}
+			queue.jobs.swap(grown);
+			queue.head = 0;
+		}
+		queue.jobs[(queue.head + queue.count) % queue.jobs.size()] = job;
+		queue.count++;
+	}
+
+	// pairs with the sleeper registering itself before it checks queuedJobs, one of the two sees the other
+	queuedJobs.fetch_add(1);
+	if (sleepers.load() > 0)
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::pop(int worker, Job& job)
+{
+	WorkerQueue& queue = queues[worker];
+	lock_guard<mutex> lock(queue.mutex);
+	if (queue.count == 0)
+	{
+		return false;
+	}
+	queue.count--;
+	job = queue.jobs[(queue.head + queue.count) % queue.jobs.size()];
+	queuedJobs.fetch_sub(1, memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::steal(int worker, Job& job)
+{
+	// xorshift, so the thieves do not all line up behind the same victim
+	t_random ^= t_random << 13;
+	t_random ^= t_random >> 17;
+	t_random ^= t_random << 5;
+	const int first = static_cast<int>(t_random % static_cast<uint32_t>(threadCount));
+	for (int i = 0; i < threadCount; i++)
+	{
+		const int victim = (first + i) % threadCount;
+		if (victim == worker)
+		{
+			continue;
+		}
+		WorkerQueue& queue = queues[victim];
+		lock_guard<mutex> lock(queue.mutex);
+		if (queue.count == 0)
+		{
+			continue;
+		}
+		job = queue.jobs[queue.head];
+		queue.head = (queue.head + 1) % queue.jobs.size();
+		queue.count--;
+		queuedJobs.fetch_sub(1, memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::execute(const Job& job, int worker, bool stolen)
+{
+	WorkerCounters& counter = counters[worker];
+	counter.jobs.fetch_add(1, memory_order_relaxed);
+	if (stolen)
+	{
+		counter.steals.fetch_add(1, memory_order_relaxed);
+	}
+
+	const bool outermost = t_depth++ == 0;
+	const auto start = outermost ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+	job.run(*this, job, worker);
+	if (outermost)
+	{
+		counter.busyNs.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(), memory_order_relaxed);
+	}
+	t_depth--;
+
+	job.counter->pending.fetch_sub(1, memory_order_release);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+	const int worker = currentWorker();
+	while (counter.pending.load(memory_order_acquire) > 0)
+	{
+		Job job;
+		if (pop(worker, job))
+		{
+			execute(job, worker, false);
+		}
+		else if (steal(worker, job))
+		{
+			execute(job, worker, true);
+		}
+		else
+		{
+			// the rest is running on other workers
+			this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::workerLoop(int worker)
+{
+	t_system = this;
+	t_worker = worker;
+	if (pinThreads)
+	{
+		pinCurrentThread(worker);
+	}
+
+	int spins = 0;
+	for (;;)
+	{
+		Job job;
+		if (pop(worker, job))
+		{
+			execute(job, worker, false);
+			spins = 0;
+			continue;
+		}
+		if (steal(worker, job))
+		{
+			execute(job, worker, true);
+			spins = 0;
+			continue;
+		}
+		if (++spins < IDLE_SPINS)
+		{
+			this_thread::yield();
+			continue;
+		}
+		spins = 0;
+
+		unique_lock<mutex> lock(sleepMutex);
+		sleepers.fetch_add(1);
+		wake.wait(lock, [this] { return quit || queuedJobs.load() > 0; });
+		sleepers.fetch_sub(1);
+		if (quit)
+		{
+			return;
+		}
+	}
+}
+
+vector<WorkerStats> JobSystem::getStats() const
+{
+	const double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - statsStart).count();
+	vector<WorkerStats> stats(threadCount);
+	for (int worker = 0; worker < threadCount; worker++)
+	{
+		const WorkerCounters& counter = counters[worker];
+		stats[worker].jobs = counter.jobs.load(memory_order_relaxed);
+		stats[worker].steals = counter.steals.load(memory_order_relaxed);
+		stats[worker].busyMs = counter.busyNs.load(memory_order_relaxed) / 1e6;
+		stats[worker].idleMs = std::max(0.0, elapsedMs - stats[worker].busyMs);
+	}
+	return stats;
+}
+
+void JobSystem::resetStats()
+{
+	for (int worker = 0; worker < threadCount; worker++)
+	{
+		counters[worker].jobs.store(0, memory_order_relaxed);
+		counters[worker].steals.store(0, memory_order_relaxed);
+		counters[worker].busyNs.store(0, memory_order_relaxed);
+	}
+	statsStart = chrono::steady_clock::now();
+}
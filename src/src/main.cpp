@@ -1,5 +1,6 @@
 #include <vector>
 #include <array>
+#include <iostream>
 #include <imgui.h>
 
 #include <glad/glad.h>
@@ -13,7 +14,9 @@
 #include <tgaimage.h>
 
 #include "vertex.h"
-#include "clip.h"
+#include "render.h"
+#include "scene.h"
+#include "jobsystem.h"
 
 using namespace std;
 using namespace glm;
@@ -165,158 +168,6 @@ void initImGui (GLFWwindow* window)
 }
 
 
-// ======== SoftRender ========
-
-struct FrameBuffer
-{
-	vector<vector<float>> zBuffer;
-	vector<vector<vec3>> colorBuffer;
-};
-
-array<int, 4> getBBox(const array<vec3, 3>& tri, const int width, const int height)
-{
-	array<int, 4> bbox = { width, height, 0, 0 };
-	for(int i=0;i<3;i++)
-	{
-		bbox[0] = std::min(bbox[0], static_cast<int>(tri[i].x));
-		bbox[1] = std::min(bbox[1], static_cast<int>(tri[i].y));
-		bbox[2] = std::max(bbox[2], static_cast<int>(tri[i].x));
-		bbox[3] = std::max(bbox[3], static_cast<int>(tri[i].y));
-	}
-	bbox[0] = std::max(bbox[0], 0);
-	bbox[1] = std::max(bbox[1], 0);
-	bbox[2] = std::min(bbox[2], width);
-	bbox[3] = std::min(bbox[3], height);
-	return bbox;
-}
-
-vec3 getBarycentricCoord(const array<vec3, 3>& abc, const vec3& p)
-{
-	vec3 x = vec3(abc[1].x - abc[0].x, abc[2].x - abc[0].x, abc[0].x - p.x);
-	vec3 y = vec3(abc[1].y - abc[0].y, abc[2].y - abc[0].y, abc[0].y - p.y);
-	vec3 cross_z = cross(x, y);
-	if (abs(static_cast<double>(cross_z.z)) < 0.01)
-	{
-		return vec3(-1, 1, 1);
-	}
-	return vec3(1 - (cross_z.x + cross_z.y) / cross_z.z, cross_z.x / cross_z.z, cross_z.y / cross_z.z);
-}
-
-void geometryProcess(vector<TriangleP>& screenTriangles,
-					const vector<Triangle>& triangles, 
-					const mat4& m, const mat4&v, const mat4& p, 
-					const int width, const int height)
-{
-	// vertex process1: modelSpace -> clipSpace
-	size_t totalTriangles = triangles.size();
-	vector<TriangleP> clipTriangles(totalTriangles);
-	for(size_t i =0;i< totalTriangles; i++)
-	{
-		const Triangle& triangle = triangles[i];
-		for(size_t j =0; j < triangle.vertices.size();j++)
-		{
-			// process in vertex shader
-			vec3 pos = triangle.vertices[j].position;
-			vec4 mvpPos = p * v * m * vec4(pos, 1.0f);
-
-			// copy attribute
-			clipTriangles[i].vertices[j].position = mvpPos;
-			clipTriangles[i].vertices[j].color = triangle.vertices[j].color;
-		}
-	}
-
-	// vertex process2: clipping in clipSpace
-	vector<TriangleP> clippedTriangles(totalTriangles);
-	Clipper<VertexP> clipper;
-	size_t clippedCount = 0, totalClippedCount = totalTriangles;
-	for(size_t i = 0;i < totalTriangles;i++)
-	{
-		array<VertexP, Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT> clipVertices = {};
-		const TriangleP& clipTriangle = clipTriangles[i];
-
-		const size_t verticesCount = clipper.clipTriangle(&clipTriangle.vertices[0], &clipVertices[0]);
-
-		if (verticesCount >= 3 && clippedCount + (verticesCount - 2) > totalClippedCount)
-		{
-			size_t addCount = clippedCount + (verticesCount - 2) - totalClippedCount + 2 * (totalClippedCount - i);
-			clippedTriangles.insert(clippedTriangles.end(), addCount, {});
-			totalClippedCount = clippedTriangles.size();
-		}
-		
-		for(size_t j = 1; j + 1 < verticesCount; j++)
-		{
-			clippedTriangles[clippedCount++].vertices = { clipVertices[0], clipVertices[j], clipVertices[j + 1] };
-		}
-	}
-
-	// vertex process3: clipSpace -> NDC and NDC -> ScreenSpace
-	if (screenTriangles.empty())
-	{
-		screenTriangles = vector<TriangleP>(clippedCount);
-	}
-	for(size_t i =0;i<clippedCount;i++)
-	{
-		const array<VertexP, 3> clippedVertices = clippedTriangles[i].vertices;
-		for(size_t j=0; j< clippedVertices.size(); j++)
-		{
-			// projection division
-			vec3 position = vec3(clippedVertices[j].position.x, clippedVertices[j].position.y, clippedVertices[j].position.z) / clippedVertices[j].position.w;
-			
-			// screen mapping
-			position = (position + vec3(1.0, 1.0, 1.0)) * vec3(width, height, 1) / 2.0f;
-
-			screenTriangles[i].vertices[j].position = vec4(position, -clippedVertices[j].position.w);
-			screenTriangles[i].vertices[j].color = clippedVertices[j].color;
-		}
-	}
-}
-
-void rasterize(const vector<TriangleP>& triangles, FrameBuffer& frameBuffer)
-{
-	size_t height = frameBuffer.zBuffer.size(), width = frameBuffer.zBuffer[0].size();
-	for(auto& triangle: triangles)
-	{
-		array<vec3, 3> triPos = {};
-		for (size_t i = 0; i < 3; i++) 
-		{
-			triPos[i] = vec3(triangle.vertices[i].position.x, triangle.vertices[i].position.y, triangle.vertices[i].position.z);
-		}
-
-		// perspective correct parameter
-		vec3 pcPV = {
-			triangle.vertices[1].position.w * triangle.vertices[2].position.w,
-			triangle.vertices[0].position.w * triangle.vertices[2].position.w,
-			triangle.vertices[0].position.w * triangle.vertices[1].position.w,
-		};
-		float pcPZ = triangle.vertices[0].position.w * triangle.vertices[1].position.w * triangle.vertices[2].position.w;
-
-		array<int, 4> triBBox = getBBox(triPos, width - 1, height - 1);
-		for (int y = triBBox[1]; y <= triBBox[3]; y++)
-		{
-			for (int x = triBBox[0]; x <= triBBox[2]; x++)
-			{
-				vec3 p = vec3(x + 0.5, y + 0.5, 0);
-				vec3 baryC = getBarycentricCoord(triPos, p);
-				if (baryC[0] >= 0 && baryC[1] >= 0 && baryC[2] >= 0)
-				{
-					// perspective projection interplote correct
-					vec3 baryCCorrect = (pcPV / dot(pcPV, baryC)) * baryC;
-					p.z = pcPZ / dot(pcPV, baryC);
-
-					// depth test
-					if (p.z < frameBuffer.zBuffer[y][x])
-					{
-						frameBuffer.zBuffer[y][x] = p.z;
-						frameBuffer.colorBuffer[y][x] = baryCCorrect[0] * triangle.vertices[0].color +
-							baryCCorrect[1] * triangle.vertices[1].color +
-							baryCCorrect[2] * triangle.vertices[2].color;
-					}
-				}
-			}
-		}
-	}
-}
-
 int main()
 {
 	const int width = 800, height = 600;
@@ -333,20 +184,16 @@ int main()
 	initImGui(window);
 	
 	// viewport
-	FrameBuffer frameBuffer;
-	frameBuffer.zBuffer = vector<vector<float>>(height, vector<float>(width, 2));
-	frameBuffer.colorBuffer = vector<vector<vec3>>(height, vector<vec3>(width, vec3(0.2f, 0.3f, 0.3f)));
+	FrameBuffer frameBuffer(width, height);
 
 	// data
-	Triangle triangle = {};
-	triangle.vertices[0] = { vec3(-1.0, -0.5, 0.0), vec3(1,0,0) };
-	triangle.vertices[1] = { vec3(0, 1.0, 0), vec3(0,1,0) };
-	triangle.vertices[2] = { vec3(1.0, -0.5, 0), vec3(0,0,1) };
+	vector<Triangle> triangles = makeTriangleScene();
 
-	vector<Triangle> triangles(1, triangle);
-
-	vector<unsigned char> imgData(3 * width * height);
+	vector<unsigned char> imgData(4 * width * height);
 	vector<TriangleP> screenTriangles;
+	JobSystem jobSystem;
+	GeometryProcessor geometryProcessor(&jobSystem);
+	TileRasterizer rasterizer(jobSystem);
 
 	while (!glfwWindowShouldClose(window))
 	{
@@ -357,21 +204,24 @@ int main()
 		mat4 view = lookAt(vec3(0, 0, 3), vec3(0, 0, 0), vec3(0, 1, 0));
 		mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
 		// geometry process
-		geometryProcess(screenTriangles, triangles, model, view, projection, width - 1, height - 1);
+		jobSystem.resetStats();
+		geometryProcessor.process(screenTriangles, triangles, model, view, projection, width - 1, height - 1);
 		// rasterization and pix process
-		rasterize(screenTriangles, frameBuffer);
-		for (size_t y = 0; y < height; y++)
+		frameBuffer.clear(2, vec3(0.2f, 0.3f, 0.3f));
+		rasterizer.rasterize(screenTriangles, frameBuffer);
+		if (frameBuffer.getLayout() == FrameBufferLayout::LINEAR)
 		{
-			for (size_t x = 0; x < width; x++)
-			{
-				vec3 color = frameBuffer.colorBuffer[y][x] * 255.0f;
-				size_t i = (y * width + x) * 3;
-				imgData[i] = static_cast<unsigned char>(color.r);
-				imgData[i + 1] = static_cast<unsigned char>(color.g);
-				imgData[i + 2] = static_cast<unsigned char>(color.b);
-			}
+			// upload the padded color attachment as is, with the blocks no triangle touched filled in
+			frameBuffer.resolveClear();
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, frameBuffer.getPitch());
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frameBuffer.colorData());
+		}
+		else
+		{
+			frameBuffer.resolveRGBA8(&imgData[0], &jobSystem);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &imgData[0]);
 		}
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, &imgData[0]);
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -379,6 +229,12 @@ int main()
 		
 		ImGui::Begin("triangle");
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		const vector<WorkerStats> workerStats = jobSystem.getStats();
+		for (size_t worker = 0; worker < workerStats.size(); worker++)
+		{
+			ImGui::Text("worker %zu: %llu jobs, %llu stolen, busy %.3f ms", worker, static_cast<unsigned long long>(workerStats[worker].jobs),
+				static_cast<unsigned long long>(workerStats[worker].steals), workerStats[worker].busyMs);
+		}
 		ImGui::End();
 
 		ImGui::Render();
@@ -0,0 +1,229 @@
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+using namespace std;
+using namespace glm;
+
+uint32_t Mesh::addVertex(const Vertex& vertex)
+{
+	positionX.push_back(vertex.position.x);
+	positionY.push_back(vertex.position.y);
+	positionZ.push_back(vertex.position.z);
+	colors.push_back(vertex.color);
+	return static_cast<uint32_t>(colors.size() - 1);
+}
+
+void Mesh::addTriangle(uint32_t a, uint32_t b, uint32_t c)
+{
+	indices.push_back(a);
+	indices.push_back(b);
+	indices.push_back(c);
+}
+
+Vertex Mesh::getVertex(uint32_t index) const
+{
+	return { vec3(positionX[index], positionY[index], positionZ[index]), colors[index] };
+}
+
+Bounds computeBounds(const Mesh& mesh)
+{
+	Bounds bounds;
+	for (size_t i = 0; i < mesh.getVertexCount(); i++)
+	{
+		const vec3 position(mesh.positionX[i], mesh.positionY[i], mesh.positionZ[i]);
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	return bounds;
+}
+
+double computeACMR(const vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+	if (indices.size() < 3)
+	{
+		return 0;
+	}
+	// FIFO: a vertex is in the cache when it was inserted less than cacheSize misses ago
+	vector<int64_t> insertedAt(vertexCount, -static_cast<int64_t>(cacheSize) - 1);
+	int64_t misses = 0;
+	for (const uint32_t index : indices)
+	{
+		if (misses - insertedAt[index] > cacheSize)
+		{
+			insertedAt[index] = misses++;
+		}
+	}
+	return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+// ======== Forsyth vertex cache optimisation ========
+
+static constexpr float CACHE_DECAY_POWER = 1.5f;
+static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		// no triangle left to use it
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// used by the last triangle: a fixed score so the next triangle does not simply strip along
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+	// vertices with few triangles left are finished first, they would otherwise be loaded again later
+	return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// vertex -> triangles, the first remaining[v] entries of a vertex are its triangles not emitted yet
+	vector<uint32_t> remaining(vertexCount, 0);
+	for (const uint32_t index : indices)
+	{
+		remaining[index]++;
+	}
+	vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	}
+	vector<uint32_t> vertexTriangles(indices.size());
+	{
+		vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				vertexTriangles[fill[indices[3 * t + corner]]++] = static_cast<uint32_t>(t);
+			}
+		}
+	}
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+	vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+	}
+	vector<bool> emitted(triangleCount, false);
+
+	// the last triangle's vertices go in front, the oldest entries fall off the end
+	array<uint32_t, VERTEX_CACHE_SIZE + 3> cache;
+	array<uint32_t, VERTEX_CACHE_SIZE + 3> nextCache;
+	int cacheCount = 0;
+
+	vector<uint32_t> output;
+	output.reserve(indices.size());
+	size_t scanStart = 0;
+	int64_t best = -1;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (best < 0)
+		{
+			// nothing in the cache has triangles left: take the best remaining triangle. a linear scan for the
+			// first one keeps the whole run linear, the scores of untouched triangles barely differ
+			while (emitted[scanStart])
+			{
+				scanStart++;
+			}
+			best = static_cast<int64_t>(scanStart);
+		}
+
+		const size_t triangle = static_cast<size_t>(best);
+		emitted[triangle] = true;
+		const uint32_t corners[3] = { indices[3 * triangle], indices[3 * triangle + 1], indices[3 * triangle + 2] };
+		output.insert(output.end(), corners, corners + 3);
+
+		// drop the triangle from the lists of its vertices
+		for (const uint32_t v : corners)
+		{
+			uint32_t* list = &vertexTriangles[firstTriangle[v]];
+			const uint32_t* found = find(list, list + remaining[v], static_cast<uint32_t>(triangle));
+			swap(list[found - list], list[remaining[v] - 1]);
+			remaining[v]--;
+		}
+
+		// new cache order: the triangle's vertices, then the old entries that are not among them
+		int nextCount = 0;
+		for (const uint32_t v : corners)
+		{
+			if (find(nextCache.begin(), nextCache.begin() + nextCount, v) == nextCache.begin() + nextCount)
+			{
+				nextCache[nextCount++] = v;
+			}
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			const uint32_t v = cache[i];
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+			{
+				nextCache[nextCount++] = v;
+			}
+		}
+
+		// rescore the vertices whose cache position changed, and the remaining triangles around them
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < nextCount; i++)
+		{
+			const uint32_t v = nextCache[i];
+			cachePosition[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+			const float newScore = vertexScore(cachePosition[v], remaining[v]);
+			const float delta = newScore - score[v];
+			score[v] = newScore;
+			for (uint32_t k = 0; k < remaining[v]; k++)
+			{
+				const uint32_t t = vertexTriangles[firstTriangle[v] + k];
+				triangleScore[t] += delta;
+			}
+		}
+		for (int i = 0; i < std::min(nextCount, VERTEX_CACHE_SIZE); i++)
+		{
+			const uint32_t v = nextCache[i];
+			for (uint32_t k = 0; k < remaining[v]; k++)
+			{
+				const uint32_t t = vertexTriangles[firstTriangle[v] + k];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(nextCount, VERTEX_CACHE_SIZE);
+		copy(nextCache.begin(), nextCache.begin() + cacheCount, cache.begin());
+	}
+	indices.swap(output);
+}
@@ -0,0 +1,222 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "occlusion.h"
+#include "transform.h"
+#include "clip.h"
+#include "simd.h"
+
+using namespace std;
+using namespace glm;
+
+// rounding of the float edge functions and depth planes, relative to the tested quantities: an occluder stays
+// inside its exact coverage and behind its exact depth
+static constexpr float COVERAGE_SLACK = 1.01f;
+static constexpr float DEPTH_MARGIN = 1e-5f;
+// triangles of smaller doubled area (pixels^2) cover no whole pixel
+static constexpr float MIN_DOUBLE_AREA = 1e-3f;
+// occluder vertices stay within this many times the view extent, where the float edge functions are precise to far
+// below COVERAGE_SLACK
+static constexpr float OCCLUDER_GUARD_BAND = 8.0f;
+
+OcclusionCuller::OcclusionCuller(const int width, const int height)
+	: m_width(width), m_height(height)
+{
+	// rows padded to whole vectors past the last pixel, the loops load and store full vectors
+	m_pitch = (width + simd::WIDTH + 15) / 16 * 16;
+	m_depth.resize(static_cast<size_t>(m_pitch) * height);
+}
+
+void OcclusionCuller::begin(const mat4& view, const mat4& projection)
+{
+	m_viewProjection = projection * view;
+	fill(m_depth.data(), m_depth.data() + m_depth.size(), 1.0f);
+	m_stats = OcclusionStats();
+}
+
+void OcclusionCuller::addOccluder(const Mesh& mesh, const mat4& model)
+{
+	const size_t vertexCount = mesh.getVertexCount();
+	m_clipX.resize(vertexCount);
+	m_clipY.resize(vertexCount);
+	m_clipZ.resize(vertexCount);
+	m_clipW.resize(vertexCount);
+	m_outcodes.resize(vertexCount);
+	transformPositions(m_viewProjection * model, mesh.positionX.data(), mesh.positionY.data(), mesh.positionZ.data(), vertexCount,
+					   m_clipX.data(), m_clipY.data(), m_clipZ.data(), m_clipW.data(), m_outcodes.data(), vec2(OCCLUDER_GUARD_BAND));
+
+	const vec2 scale(0.5f * m_width, 0.5f * m_height);
+	for (size_t t = 0; t < mesh.getTriangleCount(); t++)
+	{
+		const uint32_t* index = &mesh.indices[3 * t];
+		const uint32_t outcodes[3] = { m_outcodes[index[0]], m_outcodes[index[1]], m_outcodes[index[2]] };
+		if ((outcodes[0] & outcodes[1] & outcodes[2] & CLIP_FRUSTUM) != 0)
+		{
+			continue;
+		}
+		// clipping an occluder would only cost time, the few triangles reaching behind the eye or far out of the view
+		// are left out
+		if (((outcodes[0] | outcodes[1] | outcodes[2]) & (CLIP_Z_NEGATIVE | CLIP_GUARD_X | CLIP_GUARD_Y)) != 0 ||
+			m_clipW[index[0]] <= 0.0f || m_clipW[index[1]] <= 0.0f || m_clipW[index[2]] <= 0.0f)
+		{
+			m_stats.occluderTrianglesSkipped++;
+			continue;
+		}
+		vec3 screen[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t i = index[corner];
+			const float invW = 1.0f / m_clipW[i];
+			screen[corner] = vec3((m_clipX[i] * invW + 1.0f) * scale.x, (m_clipY[i] * invW + 1.0f) * scale.y,
+								  (m_clipZ[i] * invW + 1.0f) * 0.5f);
+		}
+		rasterizeOccluder(screen);
+	}
+}
+
+void OcclusionCuller::rasterizeOccluder(const vec3* vertices)
+{
+	using namespace simd;
+
+	vec3 v0 = vertices[0], v1 = vertices[1], v2 = vertices[2];
+	float doubleArea = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (std::abs(doubleArea) < MIN_DOUBLE_AREA)
+	{
+		return;
+	}
+	// both windings: counter clockwise from here on
+	if (doubleArea < 0.0f)
+	{
+		swap(v1, v2);
+		doubleArea = -doubleArea;
+	}
+
+	const int x0 = static_cast<int>(std::floor(std::max(std::min({ v0.x, v1.x, v2.x }), 0.0f)));
+	const int x1 = static_cast<int>(std::ceil(std::min(std::max({ v0.x, v1.x, v2.x }), static_cast<float>(m_width))));
+	const int y0 = static_cast<int>(std::floor(std::max(std::min({ v0.y, v1.y, v2.y }), 0.0f)));
+	const int y1 = static_cast<int>(std::ceil(std::min(std::max({ v0.y, v1.y, v2.y }), static_cast<float>(m_height))));
+	if (x0 >= x1 || y0 >= y1)
+	{
+		return;
+	}
+	m_stats.occluderTriangles++;
+
+	// edge i: a * (x - origin.x) + b * (y - origin.y) >= 0 inside. a pixel is covered entirely when the edge
+	// function at its centre is at least the half extent of the edge function over the pixel
+	const vec3* origins[3] = { &v0, &v1, &v2 };
+	const vec3* ends[3] = { &v1, &v2, &v0 };
+	VFloat a[3], b[3], originX[3], originY[3], threshold[3];
+	for (int edge = 0; edge < 3; edge++)
+	{
+		const float ea = origins[edge]->y - ends[edge]->y;
+		const float eb = ends[edge]->x - origins[edge]->x;
+		a[edge] = set1(ea);
+		b[edge] = set1(eb);
+		originX[edge] = set1(origins[edge]->x);
+		originY[edge] = set1(origins[edge]->y);
+		threshold[edge] = set1(0.5f * (std::abs(ea) + std::abs(eb)) * COVERAGE_SLACK);
+	}
+
+	// depth plane, its farthest value over a pixel: the centre plus the half extent, and never farther than the
+	// farthest vertex
+	const float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / doubleArea;
+	const float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / doubleArea;
+	const VFloat depthDx = set1(dzdx), depthDy = set1(dzdy);
+	const VFloat depthOrigin = set1(v0.z + 0.5f * (std::abs(dzdx) + std::abs(dzdy)) + DEPTH_MARGIN);
+	const VFloat depthLimit = set1(std::max({ v0.z, v1.z, v2.z }) + DEPTH_MARGIN);
+	const VFloat originX0 = set1(v0.x), originY0 = set1(v0.y);
+
+	const VFloat half = set1(0.5f);
+	const VInt lanes = laneIndex();
+	const VInt end = set1(x1);
+	for (int y = y0; y < y1; y++)
+	{
+		const VFloat centreY = set1(static_cast<float>(y)) + half;
+		float* row = m_depth.data() + static_cast<size_t>(y) * m_pitch;
+		for (int x = x0; x < x1; x += WIDTH)
+		{
+			const VInt pixelX = set1(x) + lanes;
+			const VFloat centreX = toFloat(pixelX) + half;
+			VInt covered = end > pixelX;
+			for (int edge = 0; edge < 3; edge++)
+			{
+				const VFloat e = a[edge] * (centreX - originX[edge]) + b[edge] * (centreY - originY[edge]);
+				covered = covered & (threshold[edge] < e);
+			}
+			if (moveMask(covered) == 0)
+			{
+				continue;
+			}
+			const VFloat depth = min(depthOrigin + depthDx * (centreX - originX0) + depthDy * (centreY - originY0), depthLimit);
+			const VFloat stored = load(row + x);
+			store(row + x, select(covered, min(stored, depth), stored));
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const Bounds& bounds, const mat4& model)
+{
+	using namespace simd;
+
+	m_stats.boundsTested++;
+	if (bounds.min.x > bounds.max.x || bounds.min.y > bounds.max.y || bounds.min.z > bounds.max.z)
+	{
+		// no vertex, nothing to draw
+		m_stats.boundsCulled++;
+		return false;
+	}
+
+	const mat4 m = m_viewProjection * model;
+	vec2 screenMin(numeric_limits<float>::max()), screenMax(-numeric_limits<float>::max());
+	float nearest = numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const vec3 position((corner & 1) ? bounds.max.x : bounds.min.x, (corner & 2) ? bounds.max.y : bounds.min.y,
+							(corner & 4) ? bounds.max.z : bounds.min.z);
+		const vec4 clip = m * vec4(position, 1.0f);
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+		{
+			// reaching in front of the near plane: its screen rectangle is unbounded
+			return true;
+		}
+		const vec3 ndc = vec3(clip) / clip.w;
+		screenMin = glm::min(screenMin, vec2(ndc));
+		screenMax = glm::max(screenMax, vec2(ndc));
+		nearest = std::min(nearest, (ndc.z + 1.0f) * 0.5f);
+	}
+
+	// clamped before the conversion, a corner close to the eye plane maps far out of the int range
+	const vec2 size(static_cast<float>(m_width), static_cast<float>(m_height));
+	const vec2 low = glm::max((screenMin + 1.0f) * 0.5f * size, vec2(0.0f));
+	const vec2 high = glm::min((screenMax + 1.0f) * 0.5f * size, size);
+	const int x0 = static_cast<int>(std::floor(low.x)), x1 = static_cast<int>(std::ceil(high.x));
+	const int y0 = static_cast<int>(std::floor(low.y)), y1 = static_cast<int>(std::ceil(high.y));
+	if (x0 >= x1 || y0 >= y1)
+	{
+		m_stats.boundsCulled++;
+		return false;
+	}
+
+	// visible as soon as one pixel is not strictly nearer than the box
+	const VFloat boxDepth = set1(nearest);
+	const VInt lanes = laneIndex();
+	const VInt end = set1(x1);
+	for (int y = y0; y < y1; y++)
+	{
+		const float* row = m_depth.data() + static_cast<size_t>(y) * m_pitch;
+		for (int x = x0; x < x1; x += WIDTH)
+		{
+			const VInt inside = end > set1(x) + lanes;
+			if (moveMask(andNot(inside, load(row + x) < boxDepth)) != 0)
+			{
+				return true;
+			}
+		}
+	}
+	m_stats.boundsCulled++;
+	return false;
+}
@@ -0,0 +1,354 @@
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "clip.h"
+#include "render.h"
+#include "render_impl.h"
+#include "simd.h"
+#include "jobsystem.h"
+#include "transform.h"
+#include "mesh.h"
+#include "shader.h"
+
+using namespace std;
+using namespace glm;
+
+array<int, 4> getBBox(const array<vec3, 3>& tri, const int width, const int height)
+{
+	array<int, 4> bbox = { width, height, 0, 0 };
+	for(int i=0;i<3;i++)
+	{
+		bbox[0] = std::min(bbox[0], static_cast<int>(tri[i].x));
+		bbox[1] = std::min(bbox[1], static_cast<int>(tri[i].y));
+		bbox[2] = std::max(bbox[2], static_cast<int>(tri[i].x));
+		bbox[3] = std::max(bbox[3], static_cast<int>(tri[i].y));
+	}
+	bbox[0] = std::max(bbox[0], 0);
+	bbox[1] = std::max(bbox[1], 0);
+	bbox[2] = std::min(bbox[2], width);
+	bbox[3] = std::min(bbox[3], height);
+	return bbox;
+}
+
+// triangles per job of the geometry stages
+static constexpr size_t GEOMETRY_GRAIN = 2048;
+
+// body(begin, end, worker) over [0, count), on the job system when there is one, as worker 0 otherwise
+template<typename Body>
+static void forEachRange(JobSystem* jobSystem, size_t count, size_t grain, const Body& body)
+{
+	if (jobSystem == nullptr)
+	{
+		body(0, count, 0);
+		return;
+	}
+	jobSystem->parallelFor(0, count, grain, body);
+}
+
+GeometryProcessor::GeometryProcessor(JobSystem* jobSystem) : jobSystem(jobSystem)
+{
+}
+
+GeometryProcessor::~GeometryProcessor() = default;
+
+// vertex process2 and 3 of triangleCount clip space triangles, fetchTriangle(i, outcodes) returns triangle i
+// and writes the outcodes of its three vertices
+template<typename FetchTriangle>
+void GeometryProcessor::clipAndMapTriangles(vector<TriangleP>& screenTriangles, const size_t triangleCount, const FetchTriangle& fetchTriangle,
+											const int width, const int height, const GeometryOptions& options, GeometryStats* stats)
+{
+	// every chunk of the input into its own list so the output keeps the input order. the lists keep their
+	// capacity from call to call, only a chunk clipped into more triangles than ever before grows
+	const size_t chunkCount = (triangleCount + GEOMETRY_GRAIN - 1) / GEOMETRY_GRAIN;
+	if (clippedChunks.size() < chunkCount)
+	{
+		clippedChunks.resize(chunkCount);
+	}
+	chunkStats.assign(chunkCount, GeometryStats());
+	// one clipper per worker, its groups keep their storage too
+	clippers.resize(jobSystem != nullptr ? jobSystem->getThreadCount() : 1);
+	forEachRange(jobSystem, chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd, int worker)
+	{
+		BatchClipper<VertexP>& clipper = clippers[worker];
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+		{
+			vector<TriangleP>& clippedTriangles = clippedChunks[chunk];
+			GeometryStats& chunkStat = chunkStats[chunk];
+			const size_t end = std::min(triangleCount, (chunk + 1) * GEOMETRY_GRAIN);
+			clippedTriangles.clear();
+			clippedTriangles.reserve(end - chunk * GEOMETRY_GRAIN);
+			clipAndMapRange(fetchTriangle, chunk * GEOMETRY_GRAIN, end, width, height, options, clipper, clippedTriangles, chunkStat);
+		}
+	});
+	chunkOffsets.assign(chunkCount + 1, 0);
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		chunkOffsets[chunk + 1] = chunkOffsets[chunk] + clippedChunks[chunk].size();
+	}
+	const size_t clippedCount = chunkOffsets[chunkCount];
+	if (stats)
+	{
+		for (const GeometryStats& chunkStat : chunkStats)
+		{
+			*stats += chunkStat;
+		}
+		stats->triangles += triangleCount;
+		stats->output += clippedCount;
+	}
+
+	// the chunks one after the other. the output is sized to this call, within its capacity when it is reused
+	screenTriangles.resize(clippedCount);
+	forEachRange(jobSystem, chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd, int)
+	{
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+		{
+			copy(clippedChunks[chunk].begin(), clippedChunks[chunk].end(), screenTriangles.begin() + chunkOffsets[chunk]);
+		}
+	});
+}
+
+void GeometryProcessor::process(vector<TriangleP>& screenTriangles,
+								const vector<Triangle>& triangles,
+								const mat4& m, const mat4& v, const mat4& p,
+								const int width, const int height,
+								const GeometryOptions& options, GeometryStats* stats)
+{
+	// vertex process1: modelSpace -> clipSpace, the mvp matrix is concatenated once per draw
+	size_t totalTriangles = triangles.size();
+	clipTriangles.resize(totalTriangles);
+	clipOutcodes.resize(3 * totalTriangles);
+	const mat4 mvp = p * v * m;
+	const vec2 guardBand = getGuardBand(width, height);
+	forEachRange(jobSystem, totalTriangles, GEOMETRY_GRAIN, [&](size_t begin, size_t end, int)
+	{
+		transformTriangles(triangles, begin, end, mvp, guardBand, GouraudShader(), &clipTriangles[begin], &clipOutcodes[3 * begin]);
+	});
+
+	const auto fetchTriangle = [&](size_t i, uint32_t* outcodes) -> const TriangleP&
+	{
+		copy_n(&clipOutcodes[3 * i], 3, outcodes);
+		return clipTriangles[i];
+	};
+	clipAndMapTriangles(screenTriangles, totalTriangles, fetchTriangle, width, height, options, stats);
+}
+
+void GeometryProcessor::process(vector<TriangleP>& screenTriangles,
+								const Mesh& mesh,
+								const mat4& m, const mat4& v, const mat4& p,
+								const int width, const int height,
+								const GeometryOptions& options, GeometryStats* stats)
+{
+	// vertex process1: every vertex of the vertex buffer exactly once, straight from the SoA positions
+	const size_t vertexCount = mesh.getVertexCount();
+	for (vector<float>* buffer : { &clipX, &clipY, &clipZ, &clipW })
+	{
+		buffer->resize(vertexCount);
+	}
+	clipOutcodes.resize(vertexCount);
+	const mat4 mvp = p * v * m;
+	const vec2 guardBand = getGuardBand(width, height);
+	forEachRange(jobSystem, vertexCount, 3 * GEOMETRY_GRAIN, [&](size_t begin, size_t end, int)
+	{
+		// process in vertex shader
+		transformPositions(mvp, &mesh.positionX[begin], &mesh.positionY[begin], &mesh.positionZ[begin], end - begin,
+			&clipX[begin], &clipY[begin], &clipZ[begin], &clipW[begin], &clipOutcodes[begin], guardBand);
+	});
+
+	// primitive assembly from the index buffer, the color of the fixed function vertex stage is a plain copy
+	const GouraudShader shader;
+	const auto fetchTriangle = [&](size_t i, uint32_t* triangleOutcodes)
+	{
+		TriangleP triangle;
+		for (size_t j = 0; j < 3; j++)
+		{
+			const uint32_t index = mesh.indices[3 * i + j];
+			triangle.vertices[j].position = vec4(clipX[index], clipY[index], clipZ[index], clipW[index]);
+			triangle.vertices[j].varyings = shader.vertex(getAttributes(mesh, index));
+			triangleOutcodes[j] = clipOutcodes[index];
+		}
+		return triangle;
+	};
+	clipAndMapTriangles(screenTriangles, mesh.getTriangleCount(), fetchTriangle, width, height, options, stats);
+}
+
+size_t GeometryProcessor::getBufferBytes() const
+{
+	size_t bytes = clipTriangles.capacity() * sizeof(TriangleP) + clipOutcodes.capacity() * sizeof(uint32_t);
+	for (const vector<float>* buffer : { &clipX, &clipY, &clipZ, &clipW })
+	{
+		bytes += buffer->capacity() * sizeof(float);
+	}
+	for (const vector<TriangleP>& clippedTriangles : clippedChunks)
+	{
+		bytes += clippedTriangles.capacity() * sizeof(TriangleP);
+	}
+	return bytes;
+}
+
+void geometryProcess(vector<TriangleP>& screenTriangles,
+					const vector<Triangle>& triangles, 
+					const mat4& m, const mat4&v, const mat4& p, 
+					const int width, const int height, JobSystem* jobSystem,
+					const GeometryOptions& options, GeometryStats* stats)
+{
+	GeometryProcessor(jobSystem).process(screenTriangles, triangles, m, v, p, width, height, options, stats);
+}
+
+void geometryProcess(vector<TriangleP>& screenTriangles,
+					const Mesh& mesh,
+					const mat4& m, const mat4& v, const mat4& p,
+					const int width, const int height, JobSystem* jobSystem,
+					const GeometryOptions& options, GeometryStats* stats)
+{
+	GeometryProcessor(jobSystem).process(screenTriangles, mesh, m, v, p, width, height, options, stats);
+}
+
+template<typename Addressing, typename Shader>
+static void rasterizeTriangles(const vector<TrianglePT<typename Shader::Varyings>>& triangles, FrameBuffer& frameBuffer, const Addressing addressing,
+							   const Shader& shader, RasterStats& stats)
+{
+	const int width = frameBuffer.getWidth(), height = frameBuffer.getHeight();
+	const ZBuffer zBuffer(frameBuffer);
+	uint32_t* colorBuffer = frameBuffer.colorData();
+	TriangleSetup<typename Shader::Varyings> setup;
+	for(auto& triangle: triangles)
+	{
+		if (!setupTriangle(triangle, width, height, setup))
+		{
+			continue;
+		}
+		stats.triangles++;
+		rasterizeTriangle(setup, setup.bbox, zBuffer, colorBuffer, addressing, shader, stats);
+	}
+}
+
+// fn(shader) with the GouraudShader of the depth pass
+template<typename Fn>
+static void withDepthPass(const DepthPass pass, const Fn& fn)
+{
+	switch (pass)
+	{
+	case DepthPass::DEPTH_ONLY:
+		fn(DepthOnlyShader<GouraudShader>(GouraudShader()));
+		break;
+	case DepthPass::EQUAL:
+		fn(DepthEqualShader<GouraudShader>(GouraudShader()));
+		break;
+	default:
+		fn(GouraudShader());
+		break;
+	}
+}
+
+void rasterize(const vector<TriangleP>& triangles, FrameBuffer& frameBuffer, RasterStats* stats, const DepthPass pass)
+{
+	RasterStats localStats;
+	withDepthPass(pass, [&](const auto& shader)
+	{
+		if (frameBuffer.getLayout() == FrameBufferLayout::TILED)
+		{
+			rasterizeTriangles(triangles, frameBuffer, frameBuffer.tiledAddressing(), shader, localStats);
+		}
+		else
+		{
+			rasterizeTriangles(triangles, frameBuffer, frameBuffer.linearAddressing(), shader, localStats);
+		}
+	});
+	if (stats != nullptr)
+	{
+		*stats += localStats;
+	}
+}
+
+// fewest triangles worth a binning job of their own
+static constexpr size_t MIN_BINNING_CHUNK = 1024;
+
+TileRasterizer::TileRasterizer(JobSystem& jobSystem) : jobSystem(jobSystem)
+{
+}
+
+TileRasterizer::~TileRasterizer() = default;
+
+void TileRasterizer::rasterize(const vector<TriangleP>& triangles, FrameBuffer& frameBuffer, RasterStats* stats, const DepthPass pass)
+{
+	const int width = frameBuffer.getWidth(), height = frameBuffer.getHeight();
+	const int binsX = (width + BIN_SIZE - 1) / BIN_SIZE, binsY = (height + BIN_SIZE - 1) / BIN_SIZE;
+	const int binCount = binsX * binsY;
+	const int threadCount = jobSystem.getThreadCount();
+
+	// binning: every job sets up one contiguous chunk of the input, walking the chunks in order keeps submission order
+	const int chunkCount = static_cast<int>(std::max<size_t>(1, std::min<size_t>(threadCount, triangles.size() / MIN_BINNING_CHUNK)));
+	setups.resize(triangles.size());
+	bins.resize(static_cast<size_t>(chunkCount) * binCount);
+	for (vector<uint32_t>& bin : bins)
+	{
+		bin.clear();
+	}
+	workerStats.assign(threadCount, RasterStats());
+
+	jobSystem.parallelFor(0, chunkCount, 1, [&](size_t first, size_t last, int worker)
+	{
+		RasterStats chunkStats;
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			const size_t begin = triangles.size() * chunk / chunkCount, end = triangles.size() * (chunk + 1) / chunkCount;
+			binTriangles(triangles.data(), begin, end, width, height, binsX, setups.data(), &bins[chunk * binCount], chunkStats);
+		}
+		workerStats[worker] += chunkStats;
+	});
+
+	// raster, one job per bin
+	withDepthPass(pass, [&](const auto& shader)
+	{
+		rasterizeBins(jobSystem, frameBuffer, chunkCount, 1, [&](int) { return setups.data(); },
+			[&](int chunk, int bin) -> const vector<uint32_t>& { return bins[static_cast<size_t>(chunk) * binCount + bin]; }, shader, workerStats);
+	});
+
+	if (stats != nullptr)
+	{
+		for (const RasterStats& workerStat : workerStats)
+		{
+			*stats += workerStat;
+		}
+	}
+}
+
+size_t TileRasterizer::getBufferBytes() const
+{
+	size_t bytes = setups.capacity() * sizeof(TriangleSetup<ColorVaryings>);
+	for (const vector<uint32_t>& bin : bins)
+	{
+		bytes += bin.capacity() * sizeof(uint32_t);
+	}
+	return bytes;
+}
+
+// the pipeline of the built-in shaders and of their Z-prepass passes, compiled once for the apps, and a check that
+// render_impl.h builds for every layout and depth pass
+#define INSTANTIATE_DRAW(Shader) \
+	template void StreamRendererT<Shader::Varyings>::draw<Shader>(const vector<Triangle>&, const Shader&, const mat4&, const mat4&, const mat4&, \
+		int, int, FrameBuffer&, const GeometryOptions&, GeometryStats*, RasterStats*); \
+	template void StreamRendererT<Shader::Varyings>::draw<Shader>(const Mesh&, const Shader&, const mat4&, const mat4&, const mat4&, \
+		int, int, FrameBuffer&, const GeometryOptions&, GeometryStats*, RasterStats*);
+#define INSTANTIATE_SHADER(Shader) \
+	INSTANTIATE_DRAW(Shader) \
+	INSTANTIATE_DRAW(DepthOnlyShader<Shader>) \
+	INSTANTIATE_DRAW(DepthEqualShader<Shader>)
+
+template class StreamRendererT<FlatShader::Varyings>;
+template class StreamRendererT<GouraudShader::Varyings>;
+template class StreamRendererT<TexturedShader::Varyings>;
+template class StreamRendererT<LambertShader::Varyings>;
+INSTANTIATE_SHADER(FlatShader)
+INSTANTIATE_SHADER(GouraudShader)
+INSTANTIATE_SHADER(TexturedShader)
+INSTANTIATE_SHADER(CutoutShader)
+INSTANTIATE_SHADER(LambertShader)
@@ -0,0 +1,197 @@
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+
+using namespace std;
+using namespace glm;
+
+vector<Triangle> makeTriangleScene()
+{
+	Triangle triangle = {};
+	triangle.vertices[0] = { vec3(-1.0, -0.5, 0.0), vec3(1,0,0) };
+	triangle.vertices[1] = { vec3(0, 1.0, 0), vec3(0,1,0) };
+	triangle.vertices[2] = { vec3(1.0, -0.5, 0), vec3(0,0,1) };
+	return vector<Triangle>(1, triangle);
+}
+
+vector<Triangle> makeSmallTrianglesScene(size_t count, float size, unsigned int seed)
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> centerX(-2.0f, 2.0f), centerY(-1.5f, 1.5f), centerZ(-0.5f, 0.5f);
+	uniform_real_distribution<float> offset(-size, size), unit(0.0f, 1.0f);
+
+	vector<Triangle> triangles(count);
+	for (Triangle& triangle : triangles)
+	{
+		const vec3 center(centerX(rng), centerY(rng), centerZ(rng));
+		for (Vertex& vertex : triangle.vertices)
+		{
+			vertex.position = center + vec3(offset(rng), offset(rng), 0.0f);
+			vertex.color = vec3(unit(rng), unit(rng), unit(rng));
+		}
+	}
+	return triangles;
+}
+
+vector<Triangle> makeLayersScene(int layers, size_t count, bool frontToBack)
+{
+	// n x n quads of two triangles per layer
+	const int n = std::max(1, static_cast<int>(std::sqrt(count / (2.0 * layers))));
+	const float extent = 2.0f, step = 2.0f * extent / n;
+	vector<Triangle> triangles;
+	triangles.reserve(static_cast<size_t>(layers) * n * n * 2);
+	for (int layer = 0; layer < layers; layer++)
+	{
+		// z from 0.5 (nearest) to -0.5
+		const int depthIndex = frontToBack ? layer : layers - 1 - layer;
+		const float z = layers > 1 ? 0.5f - static_cast<float>(depthIndex) / (layers - 1) : 0.0f;
+		const float hue = static_cast<float>(depthIndex) / layers;
+		const vec3 color = clamp(abs(fract(vec3(hue) + vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+		for (int row = 0; row < n; row++)
+		{
+			for (int column = 0; column < n; column++)
+			{
+				const float x = -extent + column * step, y = -extent + row * step;
+				const Vertex a = { vec3(x, y, z), color }, b = { vec3(x + step, y, z), color };
+				const Vertex c = { vec3(x + step, y + step, z), color * 0.8f }, d = { vec3(x, y + step, z), color * 0.8f };
+				triangles.push_back({ { a, b, c } });
+				triangles.push_back({ { a, c, d } });
+			}
+		}
+	}
+	return triangles;
+}
+
+Mesh makeSphereMesh(int rings, int segments, float radius)
+{
+	const float pi = 3.14159265358979f;
+	Mesh mesh;
+	for (int ring = 0; ring <= rings; ring++)
+	{
+		const float theta = pi * ring / rings;
+		for (int segment = 0; segment <= segments; segment++)
+		{
+			const float phi = 2.0f * pi * segment / segments;
+			const vec3 normal(std::sin(theta) * std::sin(phi), std::cos(theta), std::sin(theta) * std::cos(phi));
+			mesh.addVertex({ normal * radius, normal * 0.5f + 0.5f });
+			mesh.normals.push_back(normal);
+			mesh.uvs.push_back(vec2(static_cast<float>(segment) / segments, 1.0f - static_cast<float>(ring) / rings));
+		}
+	}
+	// a: (ring, segment), b below it, c below right, d right. counter-clockwise seen from outside
+	const auto vertexIndex = [&](int ring, int segment) { return static_cast<uint32_t>(ring * (segments + 1) + segment); };
+	for (int ring = 0; ring < rings; ring++)
+	{
+		for (int segment = 0; segment < segments; segment++)
+		{
+			const uint32_t a = vertexIndex(ring, segment), b = vertexIndex(ring + 1, segment);
+			const uint32_t c = vertexIndex(ring + 1, segment + 1), d = vertexIndex(ring, segment + 1);
+			if (ring != rings - 1)
+			{
+				mesh.addTriangle(a, b, c);
+			}
+			if (ring != 0)
+			{
+				mesh.addTriangle(a, c, d);
+			}
+		}
+	}
+	return mesh;
+}
+
+Mesh makeBoxMesh(const vec3& min, const vec3& max, const vec3& color)
+{
+	Mesh mesh;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			vec3 normal(0.0f);
+			normal[axis] = side ? 1.0f : -1.0f;
+			// u, v: the other two axes, in the order giving counter-clockwise faces seen from outside
+			const int u = side ? (axis + 1) % 3 : (axis + 2) % 3;
+			const int v = side ? (axis + 2) % 3 : (axis + 1) % 3;
+			const uint32_t first = static_cast<uint32_t>(mesh.getVertexCount());
+			for (int corner = 0; corner < 4; corner++)
+			{
+				const vec2 uv(corner == 1 || corner == 2 ? 1.0f : 0.0f, corner >= 2 ? 1.0f : 0.0f);
+				vec3 position;
+				position[axis] = side ? max[axis] : min[axis];
+				position[u] = glm::mix(min[u], max[u], uv.x);
+				position[v] = glm::mix(min[v], max[v], uv.y);
+				mesh.addVertex({ position, color });
+				mesh.normals.push_back(normal);
+				mesh.uvs.push_back(uv);
+			}
+			mesh.addTriangle(first, first + 1, first + 2);
+			mesh.addTriangle(first, first + 2, first + 3);
+		}
+	}
+	return mesh;
+}
+
+CityScene makeCityScene(int rows, int columns, unsigned int seed)
+{
+	CityScene scene;
+	mt19937 random(seed);
+	uniform_real_distribution<float> heights(2.0f, 8.0f);
+	scene.meshes.push_back(makeSphereMesh(32, 64, 0.4f));
+	const Bounds sphereBounds = computeBounds(scene.meshes[0]);
+	vector<SceneObject> spheres;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = -columns / 2; column < columns - columns / 2; column++)
+		{
+			// 3 x 3 blocks, 1 unit streets
+			const vec3 corner(column * 4.0f + 0.5f, 0.0f, -row * 4.0f - 2.0f);
+			const uint32_t building = static_cast<uint32_t>(scene.meshes.size());
+			scene.meshes.push_back(makeBoxMesh(corner - vec3(0.0f, 0.0f, 3.0f), corner + vec3(3.0f, heights(random), 0.0f), vec3(0.6f, 0.6f, 0.65f)));
+			scene.objects.push_back({ building, mat4(1.0f), computeBounds(scene.meshes[building]), true });
+			// on the street left of the block, on the street behind it, and on their crossing
+			for (const vec3 offset : { vec3(-0.5f, 0.4f, -1.5f), vec3(1.5f, 0.4f, -3.5f), vec3(-0.5f, 0.4f, -3.5f) })
+			{
+				spheres.push_back({ 0, translate(mat4(1.0f), corner + offset), sphereBounds, false });
+			}
+		}
+	}
+	scene.objects.insert(scene.objects.end(), spheres.begin(), spheres.end());
+	scene.view = lookAt(vec3(0.0f, 1.7f, 8.0f), vec3(0.0f, 1.5f, -20.0f), vec3(0, 1, 0));
+	return scene;
+}
+
+Texture makeCheckerTexture(int sizeShift, int checks, bool holes)
+{
+	Texture texture;
+	texture.widthShift = texture.heightShift = sizeShift;
+	const int size = 1 << sizeShift;
+	texture.texels.resize(static_cast<size_t>(size) * size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			const bool odd = ((x * checks / size) + (y * checks / size)) % 2 != 0;
+			const uint32_t texel = packRGBA8(odd ? vec3(0.9f, 0.9f, 0.85f) : vec3(0.15f, 0.3f, 0.6f));
+			texture.texels[static_cast<size_t>(y) * size + x] = holes && odd ? texel & 0x00ffffffu : texel;
+		}
+	}
+	return texture;
+}
+
+vector<Triangle> expandMesh(const Mesh& mesh)
+{
+	vector<Triangle> triangles(mesh.getTriangleCount());
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		for (size_t j = 0; j < 3; j++)
+		{
+			triangles[i].vertices[j] = mesh.getVertex(mesh.indices[3 * i + j]);
+		}
+	}
+	return triangles;
+}
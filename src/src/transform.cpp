@@ -0,0 +1,84 @@
+#include <glm/glm.hpp>
+
+#include "transform.h"
+#include "simd.h"
+#include "clip.h"
+
+using namespace std;
+using namespace glm;
+
+void transformPositions(const mat4& m, const float* x, const float* y, const float* z, const size_t count,
+						float* outX, float* outY, float* outZ, float* outW, uint32_t* outcodes,
+						const vec2& guardBand)
+{
+	using namespace simd;
+
+	// glm is column major: m[column][row]
+	const VFloat m00 = set1(m[0][0]), m01 = set1(m[0][1]), m02 = set1(m[0][2]), m03 = set1(m[0][3]);
+	const VFloat m10 = set1(m[1][0]), m11 = set1(m[1][1]), m12 = set1(m[1][2]), m13 = set1(m[1][3]);
+	const VFloat m20 = set1(m[2][0]), m21 = set1(m[2][1]), m22 = set1(m[2][2]), m23 = set1(m[2][3]);
+	const VFloat m30 = set1(m[3][0]), m31 = set1(m[3][1]), m32 = set1(m[3][2]), m33 = set1(m[3][3]);
+
+	const VFloat zero = set1(0.0f);
+	const VInt bitXPositive = set1(static_cast<int32_t>(CLIP_X_POSITIVE)), bitXNegative = set1(static_cast<int32_t>(CLIP_X_NEGATIVE));
+	const VInt bitYPositive = set1(static_cast<int32_t>(CLIP_Y_POSITIVE)), bitYNegative = set1(static_cast<int32_t>(CLIP_Y_NEGATIVE));
+	const VInt bitZPositive = set1(static_cast<int32_t>(CLIP_Z_POSITIVE)), bitZNegative = set1(static_cast<int32_t>(CLIP_Z_NEGATIVE));
+	const VInt bitGuardX = set1(static_cast<int32_t>(CLIP_GUARD_X)), bitGuardY = set1(static_cast<int32_t>(CLIP_GUARD_Y));
+	const VFloat guardBandX = set1(guardBand.x), guardBandY = set1(guardBand.y);
+
+	const auto transform = [&](const float* px, const float* py, const float* pz, float* ox, float* oy, float* oz, float* ow, uint32_t* oc)
+	{
+		const VFloat vx = load(px), vy = load(py), vz = load(pz);
+		const VFloat cx = m00 * vx + m10 * vy + m20 * vz + m30;
+		const VFloat cy = m01 * vx + m11 * vy + m21 * vz + m31;
+		const VFloat cz = m02 * vx + m12 * vy + m22 * vz + m32;
+		const VFloat cw = m03 * vx + m13 * vy + m23 * vz + m33;
+		store(ox, cx);
+		store(oy, cy);
+		store(oz, cz);
+		store(ow, cw);
+		if (oc)
+		{
+			// same comparisons as Clipper::computeOutcode, while the positions are still in registers
+			const VFloat negW = zero - cw;
+			const VFloat guardX = cw * guardBandX, guardY = cw * guardBandY;
+			const VFloat negGuardX = zero - guardX, negGuardY = zero - guardY;
+			store(oc, ((cw < cx) & bitXPositive) | ((cx < negW) & bitXNegative) |
+				((cw < cy) & bitYPositive) | ((cy < negW) & bitYNegative) |
+				((cw < cz) & bitZPositive) | ((cz < negW) & bitZNegative) |
+				(((guardX < cx) | (cx < negGuardX)) & bitGuardX) | (((guardY < cy) | (cy < negGuardY)) & bitGuardY));
+		}
+	};
+
+	size_t i = 0;
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		transform(x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW + i, outcodes ? outcodes + i : nullptr);
+	}
+	if (i < count)
+	{
+		// the tail goes through the same vector code: a vertex shared by two triangles transforms bit identically
+		// wherever it falls in a batch, so shared edges stay watertight
+		float tail[7][WIDTH] = {};
+		uint32_t tailOutcodes[WIDTH];
+		const size_t rest = count - i;
+		for (size_t j = 0; j < rest; j++)
+		{
+			tail[0][j] = x[i + j];
+			tail[1][j] = y[i + j];
+			tail[2][j] = z[i + j];
+		}
+		transform(tail[0], tail[1], tail[2], tail[3], tail[4], tail[5], tail[6], outcodes ? tailOutcodes : nullptr);
+		for (size_t j = 0; j < rest; j++)
+		{
+			outX[i + j] = tail[3][j];
+			outY[i + j] = tail[4][j];
+			outZ[i + j] = tail[5][j];
+			outW[i + j] = tail[6][j];
+			if (outcodes)
+			{
+				outcodes[i + j] = tailOutcodes[j];
+			}
+		}
+	}
+}
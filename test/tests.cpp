@@ -0,0 +1,633 @@
+#include <vector>
+#include <array>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "vertex.h"
+#include "render.h"
+#include "render_impl.h"
+#include "framebuffer.h"
+#include "jobsystem.h"
+#include "clip.h"
+#include "simd.h"
+
+using namespace std;
+using namespace glm;
+
+// ======== tests ========
+
+// prints the failure, returns ok
+static bool check(const bool ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("FAIL: %s\n", what);
+	}
+	return ok;
+}
+
+// screen space triangle of the rasterizer: pixels (x, y), window depth z, one color
+static TriangleP screenTriangle(const vec2& a, const vec2& b, const vec2& c, const float z = 0.5f, const vec3& color = vec3(1.0f))
+{
+	TriangleP triangle;
+	const vec2 corners[3] = { a, b, c };
+	for (int i = 0; i < 3; i++)
+	{
+		triangle.vertices[i].position = vec4(corners[i], z, -1.0f);
+		triangle.vertices[i].varyings.color = color;
+	}
+	return triangle;
+}
+
+// a rectangle tiled by the triangles of a jittered grid, shared edges in every direction and shared vertices with up
+// to 8 triangles, some of them clockwise. aligned: the inner vertices on pixel centres and corners, every edge through
+// the ties of the fill rule. the rectangle is (4, 4) - (width - 4, height - 4)
+static vector<TriangleP> makeSharedEdgeGrid(const int width, const int height, const bool aligned)
+{
+	const int cells = 6;
+	mt19937 random(aligned ? 2 : 1);
+	uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+	uniform_int_distribution<int> coin(0, 1);
+	const vec2 low(4.0f), high(width - 4.0f, height - 4.0f);
+	vector<vec2> grid((cells + 1) * (cells + 1));
+	for (int j = 0; j <= cells; j++)
+	{
+		for (int i = 0; i <= cells; i++)
+		{
+			vec2 p = low + (high - low) * vec2(i, j) / static_cast<float>(cells);
+			if (i > 0 && i < cells && j > 0 && j < cells)
+			{
+				p += (high - low) / static_cast<float>(cells) * vec2(jitter(random), jitter(random));
+				if (aligned)
+				{
+					p = floor(p * 2.0f) / 2.0f;
+				}
+			}
+			grid[j * (cells + 1) + i] = p;
+		}
+	}
+	vector<TriangleP> triangles;
+	const auto add = [&](const vec2& a, const vec2& b, const vec2& c)
+	{
+		triangles.push_back(coin(random) ? screenTriangle(a, b, c) : screenTriangle(a, c, b));
+	};
+	for (int j = 0; j < cells; j++)
+	{
+		for (int i = 0; i < cells; i++)
+		{
+			const vec2& a = grid[j * (cells + 1) + i];
+			const vec2& b = grid[j * (cells + 1) + i + 1];
+			const vec2& c = grid[(j + 1) * (cells + 1) + i + 1];
+			const vec2& d = grid[(j + 1) * (cells + 1) + i];
+			if (coin(random))
+			{
+				add(a, b, c);
+				add(a, c, d);
+			}
+			else
+			{
+				add(a, b, d);
+				add(b, c, d);
+			}
+		}
+	}
+	return triangles;
+}
+
+// top-left fill rule: every pixel of a surface tiled by triangles is covered by exactly one of them, the shared edge
+// pixels included, with the serial and the binned rasterizer and with either framebuffer layout
+bool testSharedEdgeCoverage()
+{
+	const int width = 150, height = 100;
+	JobSystem jobSystem;
+	TileRasterizer tileRasterizer(jobSystem);
+	bool ok = true;
+	for (const bool aligned : { false, true })
+	{
+		const vector<TriangleP> triangles = makeSharedEdgeGrid(width, height, aligned);
+		for (const FrameBufferLayout layout : { FrameBufferLayout::LINEAR, FrameBufferLayout::TILED })
+		{
+			for (const bool binned : { false, true })
+			{
+				FrameBuffer frameBuffer(width, height, layout);
+				vector<int> counts(width * height, 0);
+				for (const TriangleP& triangle : triangles)
+				{
+					// alone in a cleared frame buffer, its pixels are the ones not at the clear color
+					frameBuffer.clear(2, vec3(0.0f));
+					const vector<TriangleP> single = { triangle };
+					if (binned)
+					{
+						tileRasterizer.rasterize(single, frameBuffer);
+					}
+					else
+					{
+						rasterize(single, frameBuffer);
+					}
+					frameBuffer.resolveClear();
+					for (int y = 0; y < height; y++)
+					{
+						for (int x = 0; x < width; x++)
+						{
+							counts[y * width + x] += frameBuffer.color(x, y) != frameBuffer.getClearColor() ? 1 : 0;
+						}
+					}
+				}
+				// the pixel centres inside the rectangle, it has integer corners
+				int wrong = 0;
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						const bool inside = x >= 4 && x < width - 4 && y >= 4 && y < height - 4;
+						wrong += counts[y * width + x] != (inside ? 1 : 0) ? 1 : 0;
+					}
+				}
+				if (wrong != 0)
+				{
+					printf("%s grid, %s layout, %s rasterizer: %d pixels not covered exactly once\n", aligned ? "aligned" : "jittered",
+						layout == FrameBufferLayout::TILED ? "tiled" : "linear", binned ? "binned" : "serial", wrong);
+				}
+				ok = check(wrong == 0, "every pixel of the tiled rectangle covered exactly once") && ok;
+			}
+		}
+	}
+	return ok;
+}
+
+// the vertices of a clipped polygon, neighbours closer than epsilon merged: the clipping order of the planes leaves
+// an extra vertex next to a corner of the frustum now and then
+static vector<VertexP> polygonVertices(const VertexP* vertices, const size_t count, const float epsilon)
+{
+	const auto close = [&](const VertexP& a, const VertexP& b)
+	{
+		const vec4 d = abs(a.position - b.position);
+		return std::max({ d.x, d.y, d.z, d.w }) <= epsilon;
+	};
+	vector<VertexP> result;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (result.empty() || !close(result.back(), vertices[i]))
+		{
+			result.push_back(vertices[i]);
+		}
+	}
+	while (result.size() > 1 && close(result.front(), result.back()))
+	{
+		result.pop_back();
+	}
+	return result;
+}
+
+// the same polygon up to its first vertex and epsilon, positions and varyings
+static bool samePolygon(const vector<VertexP>& a, const vector<VertexP>& b, const float epsilon)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	if (a.empty())
+	{
+		return true;
+	}
+	for (size_t start = 0; start < b.size(); start++)
+	{
+		bool same = true;
+		for (size_t i = 0; i < a.size() && same; i++)
+		{
+			const VertexP& u = a[i];
+			const VertexP& v = b[(start + i) % b.size()];
+			const vec4 dp = abs(u.position - v.position);
+			const vec3 dc = abs(u.varyings.color - v.varyings.color);
+			same = std::max({ dp.x, dp.y, dp.z, dp.w, dc.x, dc.y, dc.z }) <= epsilon;
+		}
+		if (same)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// BatchClipper against the frustum gives the polygons of Clipper::clipTriangle, up to the rounding of its other plane
+// order, for random triangles crossing every plane and reaching behind the eye
+bool testBatchClipper()
+{
+	mt19937 random(3);
+	uniform_real_distribution<float> coordinate(-3.0f, 3.0f), w(-0.5f, 2.0f), color(0.0f, 1.0f);
+	const size_t count = 2000;
+	vector<TriangleP> triangles(count);
+	vector<uint32_t> outcodes[3];
+	for (vector<uint32_t>& codes : outcodes)
+	{
+		codes.resize(count);
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			VertexP& vertex = triangles[i].vertices[j];
+			vertex.position = vec4(coordinate(random), coordinate(random), coordinate(random), w(random));
+			vertex.varyings.color = vec3(color(random), color(random), color(random));
+			outcodes[j][i] = Clipper<VertexP>::computeOutcode(vertex);
+		}
+	}
+	vector<uint32_t> planes(count);
+	classifyTriangles(outcodes[0].data(), outcodes[1].data(), outcodes[2].data(), count, false, planes.data());
+
+	BatchClipper<VertexP> batchClipper;
+	batchClipper.clear();
+	vector<size_t> queued;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (planes[i] != 0 && planes[i] != CLIP_REJECT)
+		{
+			batchClipper.add(triangles[i], planes[i]);
+			queued.push_back(i);
+		}
+	}
+	batchClipper.clip();
+
+	Clipper<VertexP> clipper;
+	int mismatches = 0, visible = 0;
+	for (size_t polygon = 0; polygon < queued.size(); polygon++)
+	{
+		const TriangleP& triangle = triangles[queued[polygon]];
+		const uint32_t codes[3] = { outcodes[0][queued[polygon]], outcodes[1][queued[polygon]], outcodes[2][queued[polygon]] };
+		array<VertexP, Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT> expected, actual;
+		const size_t expectedCount = clipper.clipTriangle(triangle.vertices.data(), codes, expected.data());
+		const size_t actualCount = batchClipper.getPolygon(polygon, actual.data());
+		const float epsilon = 1e-4f;
+		visible += expectedCount > 0 ? 1 : 0;
+		if (!samePolygon(polygonVertices(expected.data(), expectedCount, epsilon), polygonVertices(actual.data(), actualCount, epsilon), 1e-3f))
+		{
+			mismatches++;
+		}
+	}
+	printf("%zu triangles, %zu clipped, %d visible, %d different polygons\n", count, queued.size(), visible, mismatches);
+	return check(visible > static_cast<int>(count / 4), "many triangles are clipped to a polygon") && check(mismatches == 0, "BatchClipper polygons are the Clipper ones");
+}
+
+// clip space triangle of one color
+static TriangleP clipSpaceTriangle(const vec4& a, const vec4& b, const vec4& c, const vec3& color = vec3(1.0f))
+{
+	TriangleP triangle;
+	const vec4 positions[3] = { a, b, c };
+	for (int i = 0; i < 3; i++)
+	{
+		triangle.vertices[i].position = positions[i];
+		triangle.vertices[i].varyings.color = color;
+	}
+	return triangle;
+}
+
+// x / w range of a polygon
+static vec2 polygonRangeX(const VertexP* vertices, const size_t count)
+{
+	vec2 range(FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < count; i++)
+	{
+		const float x = vertices[i].position.x / vertices[i].position.w;
+		range = vec2(std::min(range.x, x), std::max(range.y, x));
+	}
+	return range;
+}
+
+// with a guard band, x and y are clipped only when a vertex is outside the guard band, near and far always. the
+// x / y passes of BatchClipper clip a triangle only on the sides where one of its own vertices is outside the guard
+// band, whatever the other triangles of its group
+bool testGuardBand()
+{
+	const vec2 guardBand(4.0f);
+	// crossing the right frustum plane inside the guard band
+	const TriangleP inside = clipSpaceTriangle(vec4(0.0f, 0.0f, 0.0f, 1.0f), vec4(1.5f, -0.5f, 0.0f, 1.0f), vec4(1.5f, 0.5f, 0.0f, 1.0f));
+	// the same, crossing the near plane too
+	const TriangleP nearPlane = clipSpaceTriangle(vec4(0.0f, 0.0f, -2.0f, 1.0f), vec4(1.5f, -0.5f, 0.0f, 1.0f), vec4(1.5f, 0.5f, 0.0f, 1.0f));
+	// the same, outside the guard band on the left
+	const TriangleP wide = clipSpaceTriangle(vec4(-6.0f, 0.0f, 0.0f, 1.0f), vec4(1.5f, -0.5f, 0.0f, 1.0f), vec4(1.5f, 0.5f, 0.0f, 1.0f));
+	const auto outcodes = [&](const TriangleP& triangle)
+	{
+		array<uint32_t, 3> codes;
+		for (int i = 0; i < 3; i++)
+		{
+			codes[i] = Clipper<VertexP>::computeOutcode(triangle.vertices[i], guardBand);
+		}
+		return codes;
+	};
+
+	Clipper<VertexP> clipper;
+	array<VertexP, Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT> polygon;
+	bool ok = true;
+	array<uint32_t, 3> codes = outcodes(inside);
+	size_t count = clipper.clipTriangle(inside.vertices.data(), codes.data(), polygon.data(), true);
+	bool same = count == 3;
+	for (size_t i = 0; same && i < count; i++)
+	{
+		same = polygon[i].position == inside.vertices[i].position;
+	}
+	ok = check(same, "a triangle inside the guard band is not clipped") && ok;
+
+	codes = outcodes(nearPlane);
+	count = clipper.clipTriangle(nearPlane.vertices.data(), codes.data(), polygon.data(), true);
+	float nearest = FLT_MAX;
+	for (size_t i = 0; i < count; i++)
+	{
+		nearest = std::min(nearest, polygon[i].position.z + polygon[i].position.w);
+	}
+	ok = check(count > 3 && nearest >= -1e-6f, "the near plane is clipped inside the guard band") && ok;
+	ok = check(polygonRangeX(polygon.data(), count).y == 1.5f, "the right plane is not clipped inside the guard band") && ok;
+
+	codes = outcodes(wide);
+	count = clipper.clipTriangle(wide.vertices.data(), codes.data(), polygon.data(), true);
+	const vec2 range = polygonRangeX(polygon.data(), count);
+	ok = check(count > 3 && range.x >= -1.0f - 1e-6f && range.y <= 1.0f + 1e-6f, "x is clipped outside the guard band") && ok;
+
+	// BatchClipper: the triangle alone, then in a group full of neighbours far outside the guard band on the right
+	const TriangleP neighbour = clipSpaceTriangle(vec4(0.0f, 0.0f, 0.0f, 1.0f), vec4(10.0f, -0.5f, 0.0f, 1.0f), vec4(10.0f, 0.5f, 0.0f, 1.0f), vec3(0.0f));
+	const array<uint32_t, 3> wideCodes = outcodes(wide), neighbourCodes = outcodes(neighbour);
+	const uint32_t planes = (wideCodes[0] | wideCodes[1] | wideCodes[2]) & CLIP_FRUSTUM;
+	const uint32_t neighbourPlanes = (neighbourCodes[0] | neighbourCodes[1] | neighbourCodes[2]) & CLIP_FRUSTUM;
+	array<VertexP, Clipper<VertexP>::MAX_OUTPUT_CLIPPED_POINT> alone, grouped;
+	BatchClipper<VertexP> batchClipper;
+	batchClipper.clear();
+	batchClipper.add(wide, planes);
+	batchClipper.clip(guardBand);
+	const size_t aloneCount = batchClipper.getPolygon(0, alone.data());
+	batchClipper.clear();
+	for (int i = 0; i < simd::WIDTH; i++)
+	{
+		batchClipper.add(i == 1 ? wide : neighbour, i == 1 ? planes : neighbourPlanes);
+	}
+	batchClipper.clip(guardBand);
+	const size_t groupedCount = batchClipper.getPolygon(1, grouped.data());
+
+	same = aloneCount == groupedCount;
+	for (size_t i = 0; same && i < aloneCount; i++)
+	{
+		same = alone[i].position == grouped[i].position && alone[i].varyings.color == grouped[i].varyings.color;
+	}
+	ok = check(same, "a triangle is clipped the same alone and among neighbours") && ok;
+	ok = check(aloneCount == 4 && polygonRangeX(alone.data(), aloneCount) == vec2(-1.0f, 1.5f),
+		"BatchClipper clips the left side only") && ok;
+	return ok;
+}
+
+// fast clear: the frame buffer resolves as if every pixel had been written by clear, with the blocks the rasterizer
+// never touched still pending, and so does a frame buffer drawn into right after its construction
+bool testPendingClearResolve()
+{
+	// not a multiple of the blocks or the clear tiles
+	const int width = 150, height = 77;
+	const vec3 clearColor(0.2f, 0.3f, 0.3f);
+	const vector<TriangleP> triangles = {
+		screenTriangle(vec2(10.3f, 5.2f), vec2(70.6f, 20.1f), vec2(30.2f, 60.8f), 0.5f, vec3(1.0f, 0.5f, 0.0f)),
+		screenTriangle(vec2(100.0f, 40.0f), vec2(149.5f, 76.5f), vec2(90.0f, 76.0f), 0.25f, vec3(0.0f, 0.5f, 1.0f)),
+	};
+	JobSystem jobSystem;
+	TileRasterizer tileRasterizer(jobSystem);
+	bool ok = true;
+	for (const FrameBufferLayout layout : { FrameBufferLayout::LINEAR, FrameBufferLayout::TILED })
+	{
+		// every pixel written by the clear first
+		FrameBuffer eager(width, height, layout);
+		eager.clear(2, clearColor);
+		eager.resolveClear();
+		tileRasterizer.rasterize(triangles, eager);
+		vector<uint8_t> expected(4 * width * height), expectedBGR(3 * width * height);
+		eager.resolveRGBA8(expected.data());
+		eager.resolveBGR8(expectedBGR.data());
+
+		FrameBuffer fast(width, height, layout);
+		fast.clear(2, clearColor);
+		tileRasterizer.rasterize(triangles, fast);
+		int pending = 0;
+		for (int y = 0; y < height; y += FrameBuffer::CLEAR_BLOCK_SIZE)
+		{
+			for (int x = 0; x < width; x += FrameBuffer::CLEAR_BLOCK_SIZE)
+			{
+				pending += fast.isCleared(x, y) ? 1 : 0;
+			}
+		}
+		vector<uint8_t> actual(4 * width * height), actualBGR(3 * width * height);
+		fast.resolveRGBA8(actual.data(), &jobSystem);
+		fast.resolveBGR8(actualBGR.data(), &jobSystem);
+		ok = check(pending > 0, "the blocks no triangle touches are still pending") && ok;
+		ok = check(actual == expected, "resolveRGBA8 of pending blocks is the clear color") && ok;
+		ok = check(actualBGR == expectedBGR, "resolveBGR8 of pending blocks is the clear color") && ok;
+
+		// the attachments themselves once resolved
+		fast.resolveClear();
+		bool attachments = true;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				attachments = attachments && !fast.isCleared(x, y) && fast.color(x, y) == eager.color(x, y) && fast.depth(x, y) == eager.depth(x, y);
+			}
+		}
+		ok = check(attachments, "resolveClear writes the clear values of the pending blocks") && ok;
+
+		// no clear after the construction: cleared to DEFAULT_CLEAR_DEPTH and black, hi-Z included
+		FrameBuffer fresh(width, height, layout);
+		FrameBuffer black(width, height, layout);
+		black.clear(FrameBuffer::DEFAULT_CLEAR_DEPTH, vec3(0.0f));
+		tileRasterizer.rasterize(triangles, fresh);
+		tileRasterizer.rasterize(triangles, black);
+		vector<uint8_t> freshImage(4 * width * height), blackImage(4 * width * height);
+		fresh.resolveRGBA8(freshImage.data());
+		black.resolveRGBA8(blackImage.data());
+		ok = check(freshImage == blackImage, "a new frame buffer draws as a cleared one") && ok;
+	}
+	return ok;
+}
+
+// Z-prepass: the depth only pass then the depth equal pass draw the image of a single normal pass, with hi-Z on,
+// triangles at window depth 0 included
+bool testDepthPrepass()
+{
+	const int width = 150, height = 100;
+	const vector<TriangleP> triangles = {
+		screenTriangle(vec2(2.0f, 3.0f), vec2(140.0f, 10.0f), vec2(60.0f, 95.0f), 0.0f, vec3(1.0f, 0.0f, 0.0f)),
+		screenTriangle(vec2(100.0f, 60.0f), vec2(110.0f, 62.0f), vec2(104.0f, 70.0f), 0.0f, vec3(0.0f, 1.0f, 0.0f)),
+		screenTriangle(vec2(20.0f, 20.0f), vec2(148.0f, 30.0f), vec2(130.0f, 98.0f), 0.5f, vec3(0.0f, 0.0f, 1.0f)),
+	};
+	JobSystem jobSystem;
+	TileRasterizer tileRasterizer(jobSystem);
+	bool ok = true;
+	for (const FrameBufferLayout layout : { FrameBufferLayout::LINEAR, FrameBufferLayout::TILED })
+	{
+		for (const bool binned : { false, true })
+		{
+			const auto draw = [&](FrameBuffer& frameBuffer, const DepthPass pass)
+			{
+				if (binned)
+				{
+					tileRasterizer.rasterize(triangles, frameBuffer, nullptr, pass);
+				}
+				else
+				{
+					rasterize(triangles, frameBuffer, nullptr, pass);
+				}
+			};
+			FrameBuffer normal(width, height, layout), prepass(width, height, layout);
+			normal.clear(2, vec3(0.0f));
+			prepass.clear(2, vec3(0.0f));
+			draw(normal, DepthPass::NORMAL);
+			draw(prepass, DepthPass::DEPTH_ONLY);
+			draw(prepass, DepthPass::EQUAL);
+			vector<uint8_t> expected(4 * width * height), actual(4 * width * height);
+			normal.resolveRGBA8(expected.data());
+			prepass.resolveRGBA8(actual.data());
+			int different = 0;
+			for (size_t i = 0; i < expected.size(); i++)
+			{
+				different += expected[i] != actual[i] ? 1 : 0;
+			}
+			if (different != 0)
+			{
+				printf("%s layout, %s rasterizer: %d bytes differ\n", layout == FrameBufferLayout::TILED ? "tiled" : "linear",
+					binned ? "binned" : "serial", different);
+			}
+			ok = check(different == 0, "the Z-prepass draws the normal pass image") && ok;
+		}
+	}
+	return ok;
+}
+
+// a shader outside the built-in ones, with a varyings layout of its own: the complement of the vertex colors
+struct InvertVaryings
+{
+	vec3 inverted;
+};
+
+struct InvertShader
+{
+	using Varyings = InvertVaryings;
+	static constexpr DepthTest DEPTH_TEST = DepthTest::EARLY;
+
+	Varyings vertex(const VertexAttributes& vertex) const { return { vec3(1.0f) - vertex.color }; }
+	simd::VInt fragment(const simd::VFloat* varyings) const { return packColor(varyings); }
+};
+
+bool testCustomShader()
+{
+	const int width = 160, height = 120;
+	// triangles in front of the camera, some crossing the near plane or far outside the screen
+	mt19937 random(7);
+	uniform_real_distribution<float> xy(-4.0f, 4.0f), depth(-6.0f, 0.5f), unit(0.0f, 1.0f);
+	vector<Triangle> triangles(3000), inverted;
+	for (Triangle& triangle : triangles)
+	{
+		const vec3 center(xy(random), xy(random), depth(random));
+		for (Vertex& vertex : triangle.vertices)
+		{
+			vertex.position = center + 0.6f * vec3(xy(random), xy(random), xy(random));
+			vertex.color = vec3(unit(random), unit(random), unit(random));
+		}
+	}
+	inverted = triangles;
+	for (Triangle& triangle : inverted)
+	{
+		for (Vertex& vertex : triangle.vertices)
+		{
+			vertex.color = vec3(1.0f) - vertex.color;
+		}
+	}
+	const mat4 model(1.0f), view(1.0f);
+	const mat4 projection = perspective(radians(60.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+
+	JobSystem jobSystem;
+	StreamRendererT<InvertVaryings> customRenderer(jobSystem);
+	StreamRenderer streamRenderer(jobSystem);
+	FrameBuffer custom(width, height), gouraud(width, height);
+	custom.clear(2, vec3(0.0f));
+	gouraud.clear(2, vec3(0.0f));
+	customRenderer.draw(triangles, InvertShader(), model, view, projection, width, height, custom);
+	streamRenderer.draw(inverted, GouraudShader(), model, view, projection, width, height, gouraud);
+	vector<uint8_t> expected(4 * width * height), actual(4 * width * height);
+	gouraud.resolveRGBA8(expected.data());
+	custom.resolveRGBA8(actual.data());
+	int different = 0, background = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		different += expected[i] != actual[i] ? 1 : 0;
+	}
+	for (size_t i = 0; i < expected.size(); i += 4)
+	{
+		background += expected[i] == 0 && expected[i + 1] == 0 && expected[i + 2] == 0 ? 1 : 0;
+	}
+	if (different != 0)
+	{
+		printf("%d bytes differ\n", different);
+	}
+	bool ok = check(different == 0, "a custom shader draws the image of GouraudShader on its inverted colors");
+	ok = check(background < width * height / 2, "the scene covers the screen") && ok;
+	return ok;
+}
+
+struct Test
+{
+	const char* name;
+	const char* description;
+	bool (*run)();
+};
+
+const Test tests[] = {
+	{ "coverage", "shared edge pixels covered exactly once (top-left fill rule)", testSharedEdgeCoverage },
+	{ "clipper", "BatchClipper polygons match the scalar Clipper", testBatchClipper },
+	{ "guardband", "x / y clipped only outside the guard band, whatever the batch neighbours", testGuardBand },
+	{ "clear", "resolve of a frame buffer with pending clear blocks", testPendingClearResolve },
+	{ "prepass", "Z-prepass passes draw the image of a normal pass", testDepthPrepass },
+	{ "customshader", "StreamRendererT draws a shader of its own layout, outside render.cpp", testCustomShader },
+};
+
+int main(int argc, char** argv)
+{
+	vector<const Test*> selected;
+	for (int i = 1; i < argc; i++)
+	{
+		bool found = false;
+		for (const Test& test : tests)
+		{
+			if (strcmp(argv[i], test.name) == 0)
+			{
+				selected.push_back(&test);
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			printf("usage: %s [test ...]\n", argv[0]);
+			for (const Test& test : tests)
+			{
+				printf("  %-12s %s\n", test.name, test.description);
+			}
+			return 1;
+		}
+	}
+	if (selected.empty())
+	{
+		for (const Test& test : tests)
+		{
+			selected.push_back(&test);
+		}
+	}
+
+	int failed = 0;
+	for (const Test* test : selected)
+	{
+		printf("==== %s: %s ====\n", test->name, test->description);
+		const bool passed = test->run();
+		printf("%s\n\n", passed ? "passed" : "FAILED");
+		failed += passed ? 0 : 1;
+	}
+	return failed == 0 ? 0 : 1;
+}